@@ -0,0 +1,103 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   bench_tokenize.c                                   :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: gicomlan <gicomlan@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 17:58:30 by gicomlan          #+#    #+#             */
+/*   Updated: 2026/10/18 18:12:04 by gicomlan         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/*
+** Tokenizer microbenchmark: bitmap + command index against the old
+** two-strcmp-per-token scan, from 1k to 1M tokens.
+**
+**   cc -O2 -o bench_tokenize bench_tokenize.c           (SSE2)
+**   cc -O2 -mavx2 -o bench_tokenize bench_tokenize.c    (AVX2)
+*/
+
+#define main microshell_main
+#include "../microshell.c"
+#undef main
+
+#include <time.h>
+
+static double	ft_now(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1e9 + ts.tv_nsec);
+}
+
+// Old main loop: find each command with two strcmp per token
+static int	ft_strcmp_scan(char **argv)
+{
+	int	index = 0, commands = 0;
+
+	while (argv[index])
+	{
+		argv += index + 1;
+		index = 0;
+		while (argv[index] && strcmp(argv[index], "|") && \
+			strcmp(argv[index], ";"))
+			index++;
+		commands += index != 0;
+	}
+	return (commands);
+}
+
+// Random line of mostly words with a "|" or ";" every few tokens
+static char	**ft_make_line(int count)
+{
+	static char	*words[] = {"/bin/cat", "-n", "--color=never", "x", "", \
+		"/usr/bin/grep", "microshell", "&&", "||", "-"};
+	char		**argv;
+	int			index;
+
+	argv = malloc(sizeof(char *) * (count + 2));
+	argv[0] = "microshell";
+	for (index = 1; index <= count; index++)
+	{
+		if (rand() % 4 == 0)
+			argv[index] = rand() % 3 ? "|" : ";";
+		else
+			argv[index] = words[rand() % 10];
+	}
+	argv[count + 1] = NULL;
+	return (argv);
+}
+
+int	main(void)
+{
+	char		**argv;
+	t_command	*commands;
+	double		start, index_ns, scan_ns;
+	int			count, rounds, round, total, sink = 0;
+
+	printf("%10s %14s %14s %8s\n", "tokens", "strcmp ns/tok", "index ns/tok", \
+		"speedup");
+	for (count = 1000; count <= 1000000; count *= 10)
+	{
+		argv = ft_make_line(count);
+		rounds = 20000000 / count;
+		start = ft_now();
+		for (round = 0; round < rounds; round++)
+			sink += ft_strcmp_scan(argv);
+		scan_ns = (ft_now() - start) / rounds / count;
+		start = ft_now();
+		for (round = 0; round < rounds; round++)
+		{
+			commands = ft_build_index(argv + 1, count, &total);
+			sink += total;
+			free(commands);
+		}
+		index_ns = (ft_now() - start) / rounds / count;
+		printf("%10d %14.2f %14.2f %7.2fx\n", count, scan_ns, index_ns, \
+			scan_ns / index_ns);
+		free(argv);
+	}
+	return (sink == 42);
+}
@@ -0,0 +1,185 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   exec_gap.c                                         :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: gicomlan <gicomlan@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 22:04:37 by gicomlan          #+#    #+#             */
+/*   Updated: 2026/10/18 22:41:19 by gicomlan         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/*
+** Gap between one command's exit and the next command's start, for a line
+** of n ";"-separated groups, each a pipeline of p stages, with commands
+** prepared ahead (--prepare=4) and without (--prepare=0).
+**
+**   exec_gap [-n groups] [-p stages] [-r rounds] microshell
+**
+** Every stage is this program again ("--tick LOG GROUP", or "--drain" for
+** stages that read the pipe before theirs): it stamps
+** CLOCK_MONOTONIC when main starts and right before it exits, and appends
+** both to LOG. The gap of a group is its first start minus the last exit
+** of the group before; it includes our own exec and loader time, which is
+** the same with and without preparation.
+*/
+
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/wait.h>
+
+typedef struct s_tick
+{
+	int		group;
+	double	start;
+	double	end;
+}	t_tick;
+
+static double	ft_now(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1e6 + ts.tv_nsec / 1e3);
+}
+
+static int	ft_cmp(const void *a, const void *b)
+{
+	double	x = *(const double *)a, y = *(const double *)b;
+
+	return ((x > y) - (x < y));
+}
+
+// Function to be one stage: drain stdin when piped, then log our stamps
+static int	ft_tick(char *log, char *group, double start, int drain)
+{
+	char	buf[4096];
+	t_tick	tick;
+	int		fd;
+
+	if (drain)
+		while (read(STDIN_FILENO, buf, sizeof(buf)) > 0)
+			;
+	if ((fd = open(log, O_WRONLY | O_APPEND | O_CLOEXEC)) == -1)
+		return (1);
+	tick = (t_tick){atoi(group), start, ft_now()};
+	write(fd, &tick, sizeof(tick));
+	return (0);
+}
+
+// Function to run the line once, then add each group's gap to gaps
+static int	ft_run(char **line, char *log, int groups, double *gaps)
+{
+	t_tick	tick;
+	double	*first, *last;
+	int		fd, status, group;
+	pid_t	pid;
+
+	if ((fd = open(log, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600)) == -1)
+		return (perror(log), -1);
+	if ((pid = fork()) == 0)
+		execv(line[0], line), _exit(127);
+	waitpid(pid, &status, 0);
+	first = calloc(groups, sizeof(double));
+	last = calloc(groups, sizeof(double));
+	while (first && last && read(fd, &tick, sizeof(tick)) == sizeof(tick))
+	{
+		if (!first[tick.group] || tick.start < first[tick.group])
+			first[tick.group] = tick.start;
+		if (tick.end > last[tick.group])
+			last[tick.group] = tick.end;
+	}
+	for (group = 1; group < groups && first && last; group++)
+		gaps[group - 1] = first[group] - last[group - 1];
+	free(first);
+	free(last);
+	close(fd);
+	return (WIFEXITED(status) && !WEXITSTATUS(status) ? 0 : -1);
+}
+
+// Function to build "microshell --prepare=K self --tick LOG 0 | ... ; ..."
+static char	**ft_make_line(char *shell, char *self, char *log, int groups, \
+	int stages)
+{
+	char	**line, *num;
+	int		group, stage, pos = 2;
+
+	line = calloc(2 + groups * stages * 5 + 1, sizeof(char *));
+	for (group = 0; line && group < groups; group++)
+	{
+		if (asprintf(&num, "%d", group) == -1)
+			return (NULL);
+		for (stage = 0; stage < stages; stage++)
+		{
+			line[pos++] = self;
+			line[pos++] = stage ? "--drain" : "--tick";
+			line[pos++] = log;
+			line[pos++] = num;
+			line[pos++] = stage + 1 < stages ? "|" : ";";
+		}
+	}
+	if (line)
+		line[0] = shell, line[pos - 1] = NULL;
+	return (line);
+}
+
+static void	ft_report(char *what, double *gaps, int count)
+{
+	qsort(gaps, count, sizeof(double), ft_cmp);
+	printf("%-12s %9.1f %9.1f %9.1f %9.1f\n", what, gaps[0], \
+		gaps[count / 2], gaps[count * 9 / 10], gaps[count * 99 / 100]);
+}
+
+int	main(int argc, char **argv)
+{
+	char	log[] = "/tmp/exec_gapXXXXXX", self[4096], **line;
+	double	start = ft_now(), *gaps;
+	int		opt, groups = 100, stages = 1, rounds = 10, round, fd, mode;
+	ssize_t	len;
+
+	if (argc == 4 && (!strcmp(argv[1], "--tick") || \
+		!strcmp(argv[1], "--drain")))
+		return (ft_tick(argv[2], argv[3], start, argv[1][2] == 'd'));
+	while ((opt = getopt(argc, argv, "n:p:r:")) != -1)
+	{
+		if (opt == 'n')
+			groups = atoi(optarg);
+		else if (opt == 'p')
+			stages = atoi(optarg);
+		else if (opt == 'r')
+			rounds = atoi(optarg);
+		else
+			return (2);
+	}
+	if (optind != argc - 1 || groups < 2 || stages < 1 || rounds < 1)
+		return (fprintf(stderr, "usage: exec_gap [-n groups] [-p stages] "
+				"[-r rounds] microshell\n"), 2);
+	if ((len = readlink("/proc/self/exe", self, sizeof(self) - 1)) == -1 \
+		|| (fd = mkstemp(log)) == -1)
+		return (perror("exec_gap"), 2);
+	self[len] = '\0';
+	close(fd);
+	line = ft_make_line(argv[optind], self, log, groups, stages);
+	gaps = malloc(sizeof(double) * (groups - 1) * rounds);
+	if (!line || !gaps)
+		return (perror("exec_gap"), 2);
+	printf("%-12s %9s %9s %9s %9s   (us, %d x %d-stage groups)\n", "gap", \
+		"min", "p50", "p90", "p99", groups, stages);
+	for (mode = 0; mode < 2; mode++)
+	{
+		line[1] = mode ? "--prepare=4" : "--prepare=0";
+		for (round = 0; round < rounds; round++)
+			if (ft_run(line, log, groups, gaps + round * (groups - 1)) == -1)
+				return (fprintf(stderr, "exec_gap: run failed\n"), 2);
+		ft_report(line[1], gaps, (groups - 1) * rounds);
+	}
+	unlink(log);
+	free(gaps);
+	return (0);
+}
@@ -0,0 +1,148 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   exec_lookup.c                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: gicomlan <gicomlan@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 21:02:11 by gicomlan          #+#    #+#             */
+/*   Updated: 2026/10/18 21:30:47 by gicomlan         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/*
+** Cost of the executable path walk: one microshell line running the same
+** binary n times, copied to the bottom of a directory tree of each depth,
+** with and without the O_PATH exec cache. End to end numbers are dominated
+** by fork/exec, so the lookup itself is timed too: resolving the path (an
+** O_PATH open, the walk execve does) against the fstat a cache hit costs.
+**
+**   exec_lookup [-n commands] [-r rounds] microshell
+*/
+
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+static double	ft_now(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1e6 + ts.tv_nsec / 1e3);
+}
+
+// Function to create root/d/d/.../true, depth directories deep
+static char	*ft_make_tree(char *root, int depth)
+{
+	static char	path[4096];
+	struct stat	st;
+	int			in, out, level;
+
+	strcpy(path, root);
+	for (level = 0; level < depth; level++)
+	{
+		strcat(path, "/d");
+		if (mkdir(path, 0755) == -1 && stat(path, &st) == -1)
+			return (perror(path), NULL);
+	}
+	strcat(path, "/true");
+	if ((in = open("/bin/true", O_RDONLY)) == -1 || fstat(in, &st) == -1 \
+		|| (out = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0755)) == -1)
+		return (perror(path), NULL);
+	sendfile(out, in, NULL, st.st_size);
+	close(in);
+	close(out);
+	return (path);
+}
+
+// Function to run the line rounds times, returns microseconds per command
+static double	ft_time_line(char **argv, int commands, int rounds)
+{
+	double	start;
+	int		round, status;
+	pid_t	pid;
+
+	start = ft_now();
+	for (round = 0; round < rounds; round++)
+	{
+		if ((pid = fork()) == 0)
+			execv(argv[0], argv), _exit(127);
+		waitpid(pid, &status, 0);
+		if (!WIFEXITED(status) || WEXITSTATUS(status))
+			return (fprintf(stderr, "exec_lookup: run failed\n"), -1);
+	}
+	return ((ft_now() - start) / rounds / commands);
+}
+
+// Function to time the path walk and the cached fstat, in nanoseconds
+static void	ft_time_lookup(char *path, double *walk, double *hit)
+{
+	struct stat	st;
+	double		start;
+	int			fd, round;
+
+	start = ft_now();
+	for (round = 0; round < 100000; round++)
+		close(open(path, O_PATH | O_CLOEXEC));
+	*walk = (ft_now() - start) * 1e3 / 100000;
+	fd = open(path, O_PATH | O_CLOEXEC);
+	start = ft_now();
+	for (round = 0; round < 100000; round++)
+		fstat(fd, &st);
+	*hit = (ft_now() - start) * 1e3 / 100000;
+	close(fd);
+}
+
+int	main(int argc, char **argv)
+{
+	static int	depths[] = {1, 8, 64, 256};
+	char		root[] = "/tmp/exec_lookupXXXXXX", **line, *path, cmd[64];
+	int			opt, commands = 200, rounds = 20, index, depth;
+	double		walk, cached, walk_ns, hit_ns;
+
+	while ((opt = getopt(argc, argv, "n:r:")) != -1)
+	{
+		if (opt == 'n')
+			commands = atoi(optarg);
+		else if (opt == 'r')
+			rounds = atoi(optarg);
+		else
+			return (2);
+	}
+	if (optind != argc - 1 || commands < 1 || rounds < 1)
+		return (fprintf(stderr, "usage: exec_lookup [-n commands] "
+				"[-r rounds] microshell\n"), 2);
+	if (!mkdtemp(root) || !(line = calloc(commands * 2 + 2, sizeof(char *))))
+		return (perror("exec_lookup"), 2);
+	line[0] = argv[optind];
+	printf("%6s %12s %12s %14s %14s\n", "depth", "walk ns", "hit ns", \
+		"walk us/exec", "cached us/exec");
+	for (depth = 0; depth < (int)(sizeof(depths) / sizeof(*depths)); depth++)
+	{
+		if (!(path = ft_make_tree(root, depths[depth])))
+			return (2);
+		for (index = 0; index < commands; index++)
+		{
+			line[2 + index * 2] = path;
+			line[3 + index * 2] = index + 1 < commands ? ";" : NULL;
+		}
+		line[1] = "--no-exec-cache";
+		walk = ft_time_line(line, commands, rounds);
+		line[1] = "--";
+		cached = ft_time_line(line, commands, rounds);
+		ft_time_lookup(path, &walk_ns, &hit_ns);
+		printf("%6d %12.0f %12.0f %14.2f %14.2f\n", depths[depth], walk_ns, \
+			hit_ns, walk, cached);
+	}
+	snprintf(cmd, sizeof(cmd), "rm -rf %s", root);
+	free(line);
+	return (system(cmd) != 0);
+}
@@ -0,0 +1,161 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   grep_scan.c                                        :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: gicomlan <gicomlan@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 05:51:18 by gicomlan          #+#    #+#             */
+/*   Updated: 2026/10/19 06:24:37 by gicomlan         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/*
+** Builtin grep against GNU grep (LC_ALL=C) on a multi-gigabyte text file
+** (words, about 60 bytes a line, "zebra" on one line in 10000), GB/s per
+** needle search, counts checked equal; then the cost of a grep stage on
+** tiny input, builtin against exec'ing /usr/bin/grep.
+**
+**   grep_scan [-m megabytes] microshell
+*/
+
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <stdint.h>
+#include <sys/wait.h>
+
+#define INPUT	"/tmp/grep_scan.txt"
+#define SMALL	500
+
+static double	ft_now(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+// Function to write megabytes MiB of word lines to INPUT
+static int	ft_make_input(int megabytes)
+{
+	static const char	*words[] = {"the", "quick", "brown", "fox", "jumps", \
+		"over", "lazy", "dog", "shell", "pipe", "fork", "exec", "micro", \
+		"stage", "Bytes", "ring"};
+	static char			buf[1 << 20];
+	uint64_t			x = 88172645463325252ULL;
+	long long			left = (long long)megabytes << 20, lines = 0;
+	int					fd, pos, start;
+
+	if ((fd = open(INPUT, O_WRONLY | O_CREAT | O_TRUNC, 0644)) == -1)
+		return (0);
+	for (; left > 0; left -= pos)
+	{
+		for (pos = 0; pos < (int)sizeof(buf) - 80; lines++)
+		{
+			for (start = pos; pos - start < 56;)
+			{
+				x ^= x << 13, x ^= x >> 7, x ^= x << 17;
+				pos += sprintf(buf + pos, "%s ", lines % 10000 == 0 && \
+					pos == start ? "zebra" : words[x & 15]);
+			}
+			buf[pos - 1] = '\n';
+		}
+		if (write(fd, buf, pos) != pos)
+			return (close(fd), 0);
+	}
+	return (close(fd) == 0);
+}
+
+// Function to run line with stdin from in, returns its wall time; its
+// first output line lands in out
+static double	ft_run(char **line, char *in, char *out)
+{
+	static char	*env[] = {"LC_ALL=C", NULL};
+	double		start = ft_now();
+	int			fds[2], status, fd;
+	ssize_t		done;
+	pid_t		pid;
+
+	if (pipe(fds) == -1 || (pid = fork()) == -1)
+		return (-1);
+	if (pid == 0)
+	{
+		if ((fd = open(in, O_RDONLY)) != -1)
+			dup2(fd, STDIN_FILENO), close(fd);
+		dup2(fds[1], STDOUT_FILENO);
+		close(fds[0]), close(fds[1]);
+		execve(line[0], line, env);
+		_exit(127);
+	}
+	close(fds[1]);
+	done = read(fds[0], out, 31);
+	out[done > 0 ? done : 0] = '\0';
+	close(fds[0]);
+	waitpid(pid, &status, 0);
+	if (!WIFEXITED(status) || WEXITSTATUS(status) > 1)
+		return (-1);
+	return (ft_now() - start);
+}
+
+int	main(int argc, char **argv)
+{
+	static char	*cases[][2] = {{"-c", "zebra"}, {"-ci", "ZEBRA"}, \
+		{"-c", "e"}, {"-vc", "jumps"}, {"-c", "^z.bra"}};
+	static char	*simd[] = {"--simd=scalar", "--simd=sse2", "--simd=avx2"};
+	char		base[32], got[32];
+	int			opt, megabytes = 2048, index, mode, run;
+	double		gnu, took, gb;
+
+	while ((opt = getopt(argc, argv, "m:")) != -1)
+	{
+		if (opt == 'm')
+			megabytes = atoi(optarg);
+		else
+			return (2);
+	}
+	if (optind != argc - 1 || megabytes < 1)
+		return (fprintf(stderr, "usage: grep_scan [-m megabytes] "
+				"microshell\n"), 2);
+	if (!ft_make_input(megabytes))
+		return (perror(INPUT), unlink(INPUT), 2);
+	gb = ((long long)megabytes << 20) / 1e9;
+	printf("%-14s %8s %8s %8s %8s   (%d MiB, GB/s)\n", "grep", "GNU", \
+		"scalar", "sse2", "avx2", megabytes);
+	for (index = 0; index < 5; index++)
+	{
+		if ((gnu = ft_run((char *[]){"/usr/bin/grep", cases[index][0], \
+			cases[index][1], NULL}, INPUT, base)) < 0)
+			return (unlink(INPUT), \
+				fprintf(stderr, "grep_scan: GNU failed\n"), 1);
+		printf("%-4s %-9s %8.2f", cases[index][0], cases[index][1], \
+			gb / gnu);
+		for (mode = 0; mode < 3; mode++)
+		{
+			took = ft_run((char *[]){argv[optind], simd[mode], "grep", \
+				cases[index][0], cases[index][1], NULL}, INPUT, got);
+			if (took < 0 || strcmp(got, base))
+				return (unlink(INPUT), fprintf(stderr, "grep_scan: builtin "
+						"failed or counted differently\n"), 1);
+			printf(" %8.2f", gb / took);
+		}
+		printf("\n");
+	}
+	unlink(INPUT);
+	for (mode = 0; mode < 2; mode++)
+	{
+		took = ft_now();
+		for (run = 0; run < SMALL; run++)
+			if (ft_run((char *[]){argv[optind], \
+				mode ? "--no-optimize" : "--", mode ? "/usr/bin/grep" : "grep", \
+				"micro", NULL}, "/dev/null", got) < 0)
+				return (fprintf(stderr, "grep_scan: small run failed\n"), 1);
+		printf("%-14s %8.1f us a stage (empty input, %d runs)\n", mode ? \
+			"exec grep" : "builtin", (ft_now() - took) / SMALL * 1e6, SMALL);
+	}
+	return (0);
+}
@@ -0,0 +1,127 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   here_string.c                                      :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: gicomlan <gicomlan@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 00:12:40 by gicomlan          #+#    #+#             */
+/*   Updated: 2026/10/19 00:35:09 by gicomlan         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/*
+** Feeding a literal to a command: "cmd <<< data" against "/bin/echo data |
+** cmd", per command, for payloads from 16 bytes to past the pipe capacity
+** (where the here-string switches to a sealed memfd).
+**
+**   here_string [-r rounds] microshell         (the command is wc -c)
+*/
+
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/wait.h>
+
+static double	ft_now(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1e6 + ts.tv_nsec / 1e3);
+}
+
+// Function to run the line rounds times, returns microseconds per command
+static double	ft_time_line(char **line, int commands, int rounds)
+{
+	double	start;
+	int		round, status, null_fd;
+	pid_t	pid;
+
+	start = ft_now();
+	for (round = 0; round < rounds; round++)
+	{
+		if ((pid = fork()) == 0)
+		{
+			null_fd = open("/dev/null", O_WRONLY);
+			dup2(null_fd, STDOUT_FILENO);
+			execv(line[0], line);
+			_exit(127);
+		}
+		waitpid(pid, &status, 0);
+		if (!WIFEXITED(status) || WEXITSTATUS(status))
+			return (-1);
+	}
+	return ((ft_now() - start) / rounds / commands);
+}
+
+// Function to build a line of commands "cmd <<< data" or "echo data | cmd"
+static int	ft_make_line(char **line, char *data, int commands, int here)
+{
+	int	index, pos = 1;
+
+	for (index = 0; index < commands; index++)
+	{
+		if (!here)
+		{
+			line[pos++] = "/bin/echo";
+			line[pos++] = data;
+			line[pos++] = "|";
+		}
+		line[pos++] = "/usr/bin/wc";
+		line[pos++] = "-c";
+		if (here)
+		{
+			line[pos++] = "<<<";
+			line[pos++] = data;
+		}
+		line[pos++] = ";";
+	}
+	line[pos - 1] = NULL;
+	return (pos);
+}
+
+int	main(int argc, char **argv)
+{
+	static int	sizes[] = {16, 256, 4096, 32768, 100000};
+	char		*data, **line;
+	int			opt, rounds = 10, size, commands;
+	double		echo, here;
+
+	while ((opt = getopt(argc, argv, "r:")) != -1)
+	{
+		if (opt == 'r')
+			rounds = atoi(optarg);
+		else
+			return (2);
+	}
+	if (optind != argc - 1 || rounds < 1)
+		return (fprintf(stderr, "usage: here_string [-r rounds] microshell\n"), \
+			2);
+	if (!(data = malloc(100001)) || !(line = calloc(602, sizeof(char *))))
+		return (perror("here_string"), 2);
+	line[0] = argv[optind];
+	printf("%8s %9s %14s %14s %8s\n", "bytes", "commands", "echo | us/cmd", \
+		"<<< us/cmd", "speedup");
+	for (size = 0; size < (int)(sizeof(sizes) / sizeof(*sizes)); size++)
+	{
+		memset(data, 'x', sizes[size]);
+		data[sizes[size]] = '\0';
+		commands = 1000000 / sizes[size] < 100 ? 1000000 / sizes[size] : 100;
+		ft_make_line(line, data, commands, 0);
+		echo = ft_time_line(line, commands, rounds);
+		ft_make_line(line, data, commands, 1);
+		here = ft_time_line(line, commands, rounds);
+		if (echo < 0 || here < 0)
+			return (fprintf(stderr, "here_string: run failed\n"), 2);
+		printf("%8d %9d %14.1f %14.1f %7.2fx\n", sizes[size], commands, echo, \
+			here, echo / here);
+	}
+	free(line);
+	free(data);
+	return (0);
+}
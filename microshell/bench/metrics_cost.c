@@ -0,0 +1,119 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   metrics_cost.c                                     :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: gicomlan <gicomlan@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 08:31:47 by gicomlan          #+#    #+#             */
+/*   Updated: 2026/10/19 09:02:15 by gicomlan         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/*
+** What the metrics cost:
+**  - counter: ns per ft_metric() call, metrics off (g_metrics NULL) and on
+**    (a relaxed atomic add into the shared mapping);
+**  - shell: us per command of a line of /bin/true commands run by
+**    microshell --no-optimize (so each one forks and execs), without
+**    metrics, then with --metrics-file= (every command, fork and reap
+**    counted and timed; the server forked at startup included), the two
+**    taking turns so drift hits both alike.
+**
+**   metrics_cost [-n commands] [-r rounds] [microshell]
+*/
+
+#define main microshell_main
+#include "../microshell.c"
+#undef main
+
+#define CALLS	100000000
+
+static double	ft_now(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+// Function to time CALLS counter bumps, returns ns per call
+static double	ft_counter(void)
+{
+	double	start = ft_now();
+	int		index;
+
+	for (index = 0; index < CALLS; index++)
+		ft_metric(METRIC_COMMANDS);
+	return ((ft_now() - start) * 1e9 / CALLS);
+}
+
+// Function to run line, returns its wall time, -1 if it failed
+static double	ft_run(char **line)
+{
+	double	start = ft_now();
+	int		status;
+	pid_t	pid;
+
+	if ((pid = fork()) == -1)
+		return (-1);
+	if (pid == 0)
+	{
+		execve(line[0], line, (char *[]){NULL});
+		_exit(127);
+	}
+	waitpid(pid, &status, 0);
+	return (status ? -1 : ft_now() - start);
+}
+
+int	main(int argc, char **argv)
+{
+	char	*shell = "./microshell", **line;
+	int		opt, commands = 2000, rounds = 10, mode, round, pos;
+	double	took, best[2];
+
+	while ((opt = getopt(argc, argv, "n:r:")) != -1)
+	{
+		if (opt == 'n')
+			commands = atoi(optarg);
+		else if (opt == 'r')
+			rounds = atoi(optarg);
+		else
+			return (2);
+	}
+	if (optind < argc)
+		shell = argv[optind];
+	if (commands < 1 || rounds < 1 || \
+		!(line = calloc(commands * 2 + 4, sizeof(char *))))
+		return (fprintf(stderr, "usage: metrics_cost [-n commands] "
+				"[-r rounds] [microshell]\n"), 2);
+	printf("counter off  %8.2f ns a call\n", ft_counter());
+	if ((g_metrics = mmap(NULL, sizeof(t_metrics), PROT_READ | PROT_WRITE, \
+		MAP_SHARED | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED)
+		return (perror("mmap"), 1);
+	printf("counter on   %8.2f ns a call\n", ft_counter());
+	pos = 0;
+	line[pos++] = shell;
+	line[pos++] = "--no-optimize";
+	line[pos++] = "--";
+	for (round = 0; round < commands; round++)
+		line[pos++] = "/bin/true", line[pos++] = ";";
+	line[pos - 1] = NULL;
+	best[0] = best[1] = 1e9;
+	for (round = 0; round < rounds * 2; round++)
+	{
+		mode = round & 1;
+		line[2] = mode ? "--metrics-file=/tmp/metrics_cost.prom" : "--";
+		if ((took = ft_run(line)) < 0)
+			return (fprintf(stderr, "metrics_cost: shell failed\n"), 1);
+		best[mode] = took < best[mode] ? took : best[mode];
+	}
+	for (mode = 0; mode < 2; mode++)
+		printf("shell %-6s %8.2f us a command (%d commands, best of %d)\n", \
+			mode ? "on" : "off", best[mode] / commands * 1e6, commands, \
+			rounds);
+	unlink("/tmp/metrics_cost.prom");
+	printf("overhead     %8.2f us a command (%+.2f%%)\n", (best[1] - best[0]) \
+		/ commands * 1e6, (best[1] - best[0]) / best[0] * 100);
+	return (0);
+}
@@ -0,0 +1,104 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   par_map.c                                          :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: gicomlan <gicomlan@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 01:20:33 by gicomlan          #+#    #+#             */
+/*   Updated: 2026/10/19 01:58:46 by gicomlan         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/*
+** Scaling of the par stage on a CPU-bound line filter:
+**   seq L | awk '{...}' | md5sum        against
+**   seq L | par N awk '{...}' | md5sum  for N = 1, 2, 4, ... online CPUs
+** The digest must not change with N (the merge keeps chunk order).
+**
+**   par_map [-l lines] microshell
+*/
+
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/wait.h>
+
+#define FILTER	"{ s = 0; for (i = 0; i < 200; i++) s += i * $1 % 7; print s }"
+
+static double	ft_now(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+// Function to run the line, returns its wall time; the digest lands in sum
+static double	ft_run(char **line, char *sum)
+{
+	double	start = ft_now();
+	int		fds[2], status;
+	ssize_t	done;
+	pid_t	pid;
+
+	if (pipe(fds) == -1 || (pid = fork()) == -1)
+		return (-1);
+	if (pid == 0)
+	{
+		dup2(fds[1], STDOUT_FILENO);
+		close(fds[0]);
+		execv(line[0], line);
+		_exit(127);
+	}
+	close(fds[1]);
+	done = read(fds[0], sum, 32);
+	sum[done > 0 ? done : 0] = '\0';
+	close(fds[0]);
+	waitpid(pid, &status, 0);
+	if (!WIFEXITED(status) || WEXITSTATUS(status))
+		return (-1);
+	return (ft_now() - start);
+}
+
+int	main(int argc, char **argv)
+{
+	char	*line[16], lines[32], copies[16], base[33], sum[33];
+	int		opt, count = 300000, cpus, n;
+	double	plain, took;
+
+	while ((opt = getopt(argc, argv, "l:")) != -1)
+	{
+		if (opt == 'l')
+			count = atoi(optarg);
+		else
+			return (2);
+	}
+	if (optind != argc - 1 || count < 1)
+		return (fprintf(stderr, "usage: par_map [-l lines] microshell\n"), 2);
+	snprintf(lines, sizeof(lines), "%d", count);
+	cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	memcpy(line, (char *[]){argv[optind], "/usr/bin/seq", lines, "|", \
+		"/usr/bin/awk", FILTER, "|", "/usr/bin/md5sum", NULL}, \
+		9 * sizeof(char *));
+	if ((plain = ft_run(line, base)) < 0)
+		return (fprintf(stderr, "par_map: run failed\n"), 2);
+	printf("%-10s %9s %9s   (%d lines, %d CPUs)\n", "stage", "seconds", \
+		"speedup", count, cpus);
+	printf("%-10s %9.2f %8.2fx\n", "awk", plain, 1.0);
+	for (n = 1; n <= (cpus < 2 ? 2 : cpus); n *= 2)
+	{
+		snprintf(copies, sizeof(copies), "%d", n);
+		memcpy(line, (char *[]){argv[optind], "/usr/bin/seq", lines, "|", \
+			"par", copies, "/usr/bin/awk", FILTER, "|", "/usr/bin/md5sum", \
+			NULL}, 11 * sizeof(char *));
+		if ((took = ft_run(line, sum)) < 0 || strcmp(sum, base))
+			return (fprintf(stderr, "par_map: par %d failed or changed the "
+					"output\n", n), 1);
+		printf("par %-6d %9.2f %8.2fx\n", n, took, plain / took);
+	}
+	return (0);
+}
@@ -0,0 +1,114 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   pipe_relay.c                                       :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: gicomlan <gicomlan@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 23:10:52 by gicomlan          #+#    #+#             */
+/*   Updated: 2026/10/18 23:37:28 by gicomlan         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/*
+** Overhead of --pipe-stats: the same pipeline, "dd if=/dev/zero | cat |
+** ... | cat > /dev/null" with 1 to 8 links, with plain pipes and with a
+** splice relay on every link. Best of r runs.
+**
+**   pipe_relay [-m megabytes] [-r rounds] microshell
+*/
+
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/wait.h>
+
+static double	ft_now(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+// Function to run the line rounds times, returns the best wall time
+static double	ft_best(char **line, int rounds)
+{
+	double	best = 0, start, took;
+	int		round, status, null_fd;
+	pid_t	pid;
+
+	for (round = 0; round < rounds; round++)
+	{
+		start = ft_now();
+		if ((pid = fork()) == 0)
+		{
+			null_fd = open("/dev/null", O_RDWR);
+			dup2(null_fd, STDOUT_FILENO);
+			dup2(null_fd, STDERR_FILENO);
+			execv(line[0], line);
+			_exit(127);
+		}
+		waitpid(pid, &status, 0);
+		if (!WIFEXITED(status) || WEXITSTATUS(status))
+			return (-1);
+		took = ft_now() - start;
+		if (!round || took < best)
+			best = took;
+	}
+	return (best);
+}
+
+int	main(int argc, char **argv)
+{
+	char	*line[32], count[32];
+	int		opt, megabytes = 1024, rounds = 3, links, pos;
+	double	plain, relayed;
+
+	while ((opt = getopt(argc, argv, "m:r:")) != -1)
+	{
+		if (opt == 'm')
+			megabytes = atoi(optarg);
+		else if (opt == 'r')
+			rounds = atoi(optarg);
+		else
+			return (2);
+	}
+	if (optind != argc - 1 || megabytes < 1 || rounds < 1)
+		return (fprintf(stderr, "usage: pipe_relay [-m megabytes] [-r rounds] "
+				"microshell\n"), 2);
+	snprintf(count, sizeof(count), "count=%d", megabytes * 16);
+	printf("%5s %12s %12s %10s   (%d MiB through every link)\n", "links", \
+		"plain GB/s", "relay GB/s", "overhead", megabytes);
+	for (links = 1; links <= 8; links *= 2)
+	{
+		line[0] = argv[optind];
+		line[1] = "--no-optimize";
+		line[2] = "--";
+		pos = 3;
+		line[pos++] = "/bin/dd";
+		line[pos++] = "if=/dev/zero";
+		line[pos++] = "bs=64k";
+		line[pos++] = count;
+		line[pos++] = "status=none";
+		for (opt = 0; opt < links; opt++)
+		{
+			line[pos++] = "|";
+			line[pos++] = "/bin/cat";
+		}
+		line[pos] = NULL;
+		plain = ft_best(line, rounds);
+		line[2] = "--pipe-stats";
+		relayed = ft_best(line, rounds);
+		if (plain < 0 || relayed < 0)
+			return (fprintf(stderr, "pipe_relay: run failed\n"), 2);
+		printf("%5d %12.2f %12.2f %9.1f%%\n", links, \
+			megabytes / 1024.0 / plain, megabytes / 1024.0 / relayed, \
+			(relayed - plain) * 100 / plain);
+	}
+	return (0);
+}
@@ -0,0 +1,171 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   ring_relay.c                                       :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: gicomlan <gicomlan@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 04:06:52 by gicomlan          #+#    #+#             */
+/*   Updated: 2026/10/19 04:38:19 by gicomlan         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/*
+** GB/s of the link between two internal stages, ring against pipe:
+**  - transport: a producer process copies a buffer into the link, the
+**    consumer copies it back out, chunk sizes from 4 KiB to 256 KiB;
+**  - shell: "< file | > /dev/null" run by microshell with --ring=always,
+**    then with --ring=off (two copy stages: splice through a pipe).
+**
+**   ring_relay [-m megabytes] [microshell]
+*/
+
+#define main microshell_main
+#include "../microshell.c"
+#undef main
+
+static double	ft_now(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+// Function to move total bytes through the ring in chunk-sized copies
+static void	ft_ring_side(t_ring *ring, int producer, char *buf, \
+	size_t chunk, size_t total)
+{
+	char	*at;
+	size_t	len;
+
+	while (total)
+	{
+		if (!(len = producer ? ft_ring_reserve(ring, &at) \
+			: ft_ring_peek(ring, &at)))
+			_exit(1);
+		len = len < chunk ? len : chunk;
+		len = len < total ? len : total;
+		if (producer)
+			memcpy(at, buf, len), ft_ring_publish(ring, len);
+		else
+			memcpy(buf, at, len), ft_ring_consume(ring, len);
+		total -= len;
+	}
+	if (producer)
+		ft_ring_close(ring, 1);
+	_exit(0);
+}
+
+// Function to move total bytes through a pipe in chunk-sized writes/reads
+static void	ft_pipe_side(int *fds, int producer, char *buf, size_t chunk, \
+	size_t total)
+{
+	ssize_t	done;
+
+	close(fds[producer ? 0 : 1]);
+	while (total)
+	{
+		done = producer ? write(fds[1], buf, chunk < total ? chunk : total) \
+			: read(fds[0], buf, chunk < total ? chunk : total);
+		if (done <= 0)
+			_exit(1);
+		total -= done;
+	}
+	_exit(0);
+}
+
+// Function to time one transport run, returns GB/s (-1 on failure)
+static double	ft_transport(int ring, size_t chunk, size_t total)
+{
+	static char	buf[2][RING_CHUNK];
+	t_ring		*link = NULL;
+	int			fds[2] = {-1, -1}, side, status, failed = 0;
+	pid_t		pid[2];
+	double		start = ft_now();
+
+	if (ring)
+	{
+		if ((link = mmap(NULL, sizeof(t_ring), PROT_READ | PROT_WRITE, \
+			MAP_SHARED | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED)
+			return (-1);
+	}
+	else if (pipe(fds) == -1)
+		return (-1);
+	memset(buf[1], 'x', sizeof(buf[1]));
+	for (side = 0; side < 2; side++)
+		if ((pid[side] = fork()) == 0 && ring)
+			ft_ring_side(link, side, buf[side], chunk, total);
+		else if (pid[side] == 0)
+			ft_pipe_side(fds, side, buf[side], chunk, total);
+	if (!ring)
+		close(fds[0]), close(fds[1]);
+	for (side = 0; side < 2; side++)
+		failed |= waitpid(pid[side], &status, 0) == -1 || status;
+	if (ring)
+		munmap(link, sizeof(t_ring));
+	return (failed ? -1 : total / (ft_now() - start) / 1e9);
+}
+
+// Function to time "< in | > out" under microshell, returns GB/s
+static double	ft_shell(char *shell, char *option, char *in, size_t total)
+{
+	char	*line[] = {shell, option, "<", in, "|", ">", "/dev/null", NULL};
+	double	start = ft_now();
+	int		status;
+	pid_t	pid;
+
+	if ((pid = fork()) == 0)
+		execv(shell, line), _exit(127);
+	if (waitpid(pid, &status, 0) == -1 || status)
+		return (-1);
+	return (total / (ft_now() - start) / 1e9);
+}
+
+int	main(int argc, char **argv)
+{
+	static const size_t	chunks[] = {4096, 16384, 65536, 262144};
+	char				in[] = "/tmp/ring_relayXXXXXX", block[1 << 16];
+	int					opt, megabytes = 1024, fd, index;
+	size_t				total;
+	double				ring, piped;
+
+	while ((opt = getopt(argc, argv, "m:")) != -1)
+	{
+		if (opt == 'm')
+			megabytes = atoi(optarg);
+		else
+			return (2);
+	}
+	if (optind < argc - 1 || megabytes < 1)
+		return (fprintf(stderr, "usage: ring_relay [-m megabytes] "
+				"[microshell]\n"), 2);
+	total = (size_t)megabytes << 20;
+	printf("%-10s %10s %10s   (%d MiB, GB/s)\n", "chunk", "ring", "pipe", \
+		megabytes);
+	for (index = 0; index < 4; index++)
+	{
+		ring = ft_transport(1, chunks[index], total);
+		piped = ft_transport(0, chunks[index], total);
+		if (ring < 0 || piped < 0)
+			return (fprintf(stderr, "ring_relay: transport failed\n"), 1);
+		printf("%-10zu %10.2f %10.2f\n", chunks[index], ring, piped);
+	}
+	if (optind == argc)
+		return (0);
+	if ((fd = mkstemp(in)) == -1)
+		return (perror("ring_relay"), 2);
+	memset(block, 'x', sizeof(block));
+	for (index = 0; index < megabytes * 16; index++)
+		if (write(fd, block, sizeof(block)) != sizeof(block))
+			return (perror("ring_relay"), unlink(in), 2);
+	close(fd);
+	ring = ft_shell(argv[optind], "--ring=always", in, total);
+	piped = ft_shell(argv[optind], "--ring=off", in, total);
+	unlink(in);
+	if (ring < 0 || piped < 0)
+		return (fprintf(stderr, "ring_relay: shell run failed\n"), 1);
+	printf("%-10s %10.2f %10.2f   (< file | > /dev/null)\n", "shell", ring, \
+		piped);
+	return (0);
+}
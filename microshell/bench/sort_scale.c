@@ -0,0 +1,171 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   sort_scale.c                                       :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: gicomlan <gicomlan@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 07:41:03 by gicomlan          #+#    #+#             */
+/*   Updated: 2026/10/19 08:12:56 by gicomlan         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/*
+** Builtin sort against GNU sort (LC_ALL=C) on a generated file of
+** "word<TAB>number<TAB>word" lines: seconds per run for a plain sort, a
+** numeric key and a unique key, GNU first, then the builtin at 1, 2, 4 ...
+** threads; every output is hashed and must match GNU's. -M caps the
+** builtin's memory (--sort-mem) so inputs past it go through run files.
+**
+**   sort_scale [-m megabytes] [-j max_threads] [-M sort_mem_mb] microshell
+*/
+
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <stdint.h>
+#include <sys/wait.h>
+
+#define INPUT	"/tmp/sort_scale.txt"
+#define CASES	3
+
+static char	*g_cases[CASES][5] = {{NULL}, {"-t", "\t", "-k2,2n", NULL}, \
+	{"-u", "-k1,1", NULL}};
+static char	*g_names[CASES] = {"plain", "-k2,2n", "-u -k1,1"};
+
+static double	ft_now(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+// Function to write megabytes MiB of random lines to INPUT
+static int	ft_make_input(int megabytes)
+{
+	static char	buf[1 << 20];
+	uint64_t	x = 88172645463325252ULL;
+	long long	left = (long long)megabytes << 20;
+	int			fd, pos, len, word;
+
+	if ((fd = open(INPUT, O_WRONLY | O_CREAT | O_TRUNC, 0644)) == -1)
+		return (0);
+	for (; left > 0; left -= pos)
+	{
+		for (pos = 0; pos < (int)sizeof(buf) - 64;)
+		{
+			for (word = 0; word < 3; word++)
+			{
+				x ^= x << 13, x ^= x >> 7, x ^= x << 17;
+				if (word == 1)
+					pos += sprintf(buf + pos, "\t%llu\t", \
+						(unsigned long long)(x >> 40));
+				else
+					for (len = 4 + x % 12; len--; x >>= 2)
+						buf[pos++] = 'a' + (x & 15) + (x >> 60);
+			}
+			buf[pos++] = '\n';
+		}
+		if (write(fd, buf, pos) != pos)
+			return (close(fd), 0);
+	}
+	return (close(fd) == 0);
+}
+
+// Function to run line on INPUT, hashing its output (FNV-1a) into hash;
+// returns its wall time, -1 if it failed
+static double	ft_run(char **line, uint64_t *hash)
+{
+	static char	*env[] = {"LC_ALL=C", NULL};
+	static char	buf[1 << 16];
+	double		start = ft_now();
+	int			fds[2], status, fd;
+	ssize_t		done, index;
+	pid_t		pid;
+
+	if (pipe(fds) == -1 || (pid = fork()) == -1)
+		return (-1);
+	if (pid == 0)
+	{
+		if ((fd = open(INPUT, O_RDONLY)) != -1)
+			dup2(fd, STDIN_FILENO), close(fd);
+		dup2(fds[1], STDOUT_FILENO);
+		close(fds[0]), close(fds[1]);
+		execve(line[0], line, env);
+		_exit(127);
+	}
+	close(fds[1]);
+	*hash = 14695981039346656037ULL;
+	while ((done = read(fds[0], buf, sizeof(buf))) > 0)
+		for (index = 0; index < done; index++)
+			*hash = (*hash ^ (unsigned char)buf[index]) * 1099511628211ULL;
+	close(fds[0]);
+	waitpid(pid, &status, 0);
+	return (status ? -1 : ft_now() - start);
+}
+
+// Function to time one case: GNU sort, then the builtin per thread count
+static int	ft_case(char *shell, int index, int max_threads, int mem)
+{
+	char		*line[16], threads[32], budget[32];
+	uint64_t	gnu, ours;
+	double		took;
+	int			count, pos;
+
+	line[0] = "/usr/bin/sort";
+	for (count = 0; g_cases[index][count]; count++)
+		line[1 + count] = g_cases[index][count];
+	line[1 + count] = NULL;
+	if ((took = ft_run(line, &gnu)) < 0)
+		return (fprintf(stderr, "sort_scale: GNU sort failed\n"), 0);
+	printf("%-10s %8.2f", g_names[index], took);
+	snprintf(budget, sizeof(budget), "--sort-mem=%lld", (long long)mem << 20);
+	for (pos = 1; pos <= max_threads; pos *= 2)
+	{
+		snprintf(threads, sizeof(threads), "--sort-threads=%d", pos);
+		line[0] = shell, line[1] = threads, line[2] = budget, line[3] = "sort";
+		memcpy(line + 4, g_cases[index], (count + 1) * sizeof(char *));
+		if ((took = ft_run(line, &ours)) < 0 || ours != gnu)
+			return (fprintf(stderr, "\nsort_scale: builtin failed or sorted "
+					"differently\n"), 0);
+		printf(" %8.2f", took);
+	}
+	return (printf("\n"), 1);
+}
+
+int	main(int argc, char **argv)
+{
+	int	opt, megabytes = 100, max_threads, mem = 256, index, pos;
+
+	max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	while ((opt = getopt(argc, argv, "m:j:M:")) != -1)
+	{
+		if (opt == 'm')
+			megabytes = atoi(optarg);
+		else if (opt == 'j')
+			max_threads = atoi(optarg);
+		else if (opt == 'M')
+			mem = atoi(optarg);
+		else
+			return (2);
+	}
+	if (optind != argc - 1 || megabytes < 1 || max_threads < 1 || mem < 1)
+		return (fprintf(stderr, "usage: sort_scale [-m megabytes] "
+				"[-j max_threads] [-M sort_mem_mb] microshell\n"), 2);
+	if (!ft_make_input(megabytes))
+		return (perror(INPUT), unlink(INPUT), 2);
+	printf("%-10s %8s", "sort", "GNU");
+	for (pos = 1; pos <= max_threads; pos *= 2)
+		printf(" %7dt", pos);
+	printf("   (%d MiB, --sort-mem=%dM, seconds)\n", megabytes, mem);
+	for (index = 0; index < CASES; index++)
+		if (!ft_case(argv[optind], index, max_threads, mem))
+			return (unlink(INPUT), 1);
+	unlink(INPUT);
+	return (0);
+}
@@ -0,0 +1,163 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   startup.c                                          :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: gicomlan <gicomlan@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 19:31:02 by gicomlan          #+#    #+#             */
+/*   Updated: 2026/10/18 20:02:40 by gicomlan         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/*
+** Startup latency of microshell builds: "./microshell /bin/true".
+**
+**   startup [-n runs] [-c command] binary...
+**
+** For each binary two distributions are printed, both measured from a
+** timestamp the child takes right before execve(binary):
+**   fork  time until the shell's first fork (seen by ptrace, which
+**         stops the shell there - only that stop is traced)
+**   exit  time until the shell has exited and been reaped (no ptrace)
+*/
+
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/ptrace.h>
+#include <sys/wait.h>
+
+static double	ft_now(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1e6 + ts.tv_nsec / 1e3);
+}
+
+static int	ft_cmp(const void *a, const void *b)
+{
+	double	x = *(const double *)a, y = *(const double *)b;
+
+	return ((x > y) - (x < y));
+}
+
+// Function to start "binary command" and return its pid; the child
+// stamps the time right before execve into *stamp
+static pid_t	ft_spawn(char *binary, char *command, double *stamp, int traced)
+{
+	char	*argv[] = {binary, command, NULL};
+	pid_t	pid;
+
+	if ((pid = fork()) == -1)
+		perror("startup: fork"), exit(2);
+	if (pid == 0)
+	{
+		if (traced)
+			raise(SIGSTOP);
+		*stamp = ft_now();
+		execv(binary, argv);
+		_exit(127);
+	}
+	return (pid);
+}
+
+// Function to time one run up to the shell's first fork
+static double	ft_time_fork(char *binary, char *command, double *stamp)
+{
+	int		status;
+	pid_t	pid, child = 0;
+	double	at = -1;
+
+	pid = ft_spawn(binary, command, stamp, 1);
+	waitpid(pid, &status, WSTOPPED);
+	if (ptrace(PTRACE_SEIZE, pid, 0, PTRACE_O_TRACEFORK | PTRACE_O_TRACEVFORK \
+		| PTRACE_O_TRACECLONE | PTRACE_O_EXITKILL) == -1)
+		perror("startup: ptrace"), exit(2);
+	kill(pid, SIGCONT);
+	while (waitpid(pid, &status, __WALL) == pid && !WIFEXITED(status) \
+		&& !WIFSIGNALED(status))
+	{
+		if (status >> 8 == (SIGTRAP | PTRACE_EVENT_FORK << 8) || status >> 8 \
+			== (SIGTRAP | PTRACE_EVENT_VFORK << 8) || status >> 8 == \
+			(SIGTRAP | PTRACE_EVENT_CLONE << 8))
+		{
+			at = ft_now() - *stamp;
+			ptrace(PTRACE_GETEVENTMSG, pid, 0, &child);
+			ptrace(PTRACE_DETACH, pid, 0, 0);
+			break ;
+		}
+		ptrace(PTRACE_CONT, pid, 0, WIFSTOPPED(status) && WSTOPSIG(status) \
+			!= SIGTRAP && WSTOPSIG(status) != SIGSTOP ? WSTOPSIG(status) : 0);
+	}
+	if (child > 0)
+	{
+		waitpid(child, &status, __WALL);
+		ptrace(PTRACE_DETACH, child, 0, 0);
+	}
+	waitpid(pid, &status, 0);
+	return (at);
+}
+
+// Function to time one run up to the shell's exit
+static double	ft_time_exit(char *binary, char *command, double *stamp)
+{
+	int		status;
+	pid_t	pid;
+
+	pid = ft_spawn(binary, command, stamp, 0);
+	waitpid(pid, &status, 0);
+	return (ft_now() - *stamp);
+}
+
+static void	ft_report(char *binary, char *what, double *samples, int runs)
+{
+	qsort(samples, runs, sizeof(double), ft_cmp);
+	printf("%-32s %-5s %9.1f %9.1f %9.1f %9.1f %9.1f\n", binary, what, \
+		samples[0], samples[runs / 2], samples[runs * 9 / 10], \
+		samples[runs * 99 / 100], samples[runs - 1]);
+}
+
+int	main(int argc, char **argv)
+{
+	double	*stamp, *samples;
+	char	*command = "/bin/true";
+	int		opt, runs = 1000, run, index;
+
+	while ((opt = getopt(argc, argv, "n:c:")) != -1)
+	{
+		if (opt == 'n')
+			runs = atoi(optarg);
+		else if (opt == 'c')
+			command = optarg;
+		else
+			return (2);
+	}
+	if (optind == argc || runs < 1)
+		return (fprintf(stderr, "usage: startup [-n runs] [-c command] "
+				"binary...\n"), 2);
+	stamp = mmap(NULL, sizeof(double), PROT_READ | PROT_WRITE, \
+		MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	samples = malloc(sizeof(double) * runs);
+	if (stamp == MAP_FAILED || !samples)
+		return (perror("startup"), 2);
+	printf("%-32s %-5s %9s %9s %9s %9s %9s   (us)\n", "binary", "until", \
+		"min", "p50", "p90", "p99", "max");
+	for (index = optind; index < argc; index++)
+	{
+		for (run = 0; run < runs; run++)
+			samples[run] = ft_time_fork(argv[index], command, stamp);
+		ft_report(argv[index], "fork", samples, runs);
+		for (run = 0; run < runs; run++)
+			samples[run] = ft_time_exit(argv[index], command, stamp);
+		ft_report(argv[index], "exit", samples, runs);
+	}
+	free(samples);
+	return (0);
+}
@@ -0,0 +1,134 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   teardown.c                                         :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: gicomlan <gicomlan@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 02:31:07 by gicomlan          #+#    #+#             */
+/*   Updated: 2026/10/19 02:58:14 by gicomlan         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/*
+** How long "producer | head -n 1" takes when the producer would write a
+** gigabyte, with early teardown (--teardown=50) and without (off). The
+** producer is this program again ("--produce MiB"), generating text lines;
+** with "--deaf" it ignores SIGPIPE and write errors, like a program that
+** keeps computing whatever happens to its output.
+**
+**   teardown [-m megabytes] microshell
+*/
+
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <time.h>
+#include <stdint.h>
+#include <sys/wait.h>
+
+static double	ft_now(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+// Function to be the producer: megabytes MiB of 64-byte hex lines
+static int	ft_produce(int megabytes, int deaf)
+{
+	static const char	hex[] = "0123456789abcdef";
+	char				buf[65536];
+	uint64_t			x = 88172645463325252ULL;
+	long long			left = (long long)megabytes << 20;
+	int					pos;
+
+	if (deaf)
+		signal(SIGPIPE, SIG_IGN);
+	for (; left > 0; left -= sizeof(buf))
+	{
+		for (pos = 0; pos < (int)sizeof(buf); pos++)
+		{
+			x ^= x << 13, x ^= x >> 7, x ^= x << 17;
+			buf[pos] = (pos & 63) == 63 ? '\n' : hex[x & 15];
+		}
+		if (write(STDOUT_FILENO, buf, sizeof(buf)) == -1 && !deaf)
+			return (1);
+	}
+	return (0);
+}
+
+// Function to run the line once, returns its wall time
+static double	ft_run(char **line)
+{
+	double	start = ft_now();
+	int		status, null_fd;
+	pid_t	pid;
+
+	if ((pid = fork()) == 0)
+	{
+		null_fd = open("/dev/null", O_WRONLY);
+		dup2(null_fd, STDOUT_FILENO);
+		execv(line[0], line);
+		_exit(127);
+	}
+	waitpid(pid, &status, 0);
+	if (!WIFEXITED(status) || WEXITSTATUS(status))
+		return (-1);
+	return (ft_now() - start);
+}
+
+int	main(int argc, char **argv)
+{
+	char	self[4096], size[32], *line[16];
+	int		opt, megabytes = 1024, deaf, pos;
+	double	off, early;
+	ssize_t	len;
+
+	if (argc >= 3 && !strcmp(argv[1], "--produce"))
+		return (ft_produce(atoi(argv[2]), argc == 4));
+	while ((opt = getopt(argc, argv, "m:")) != -1)
+	{
+		if (opt == 'm')
+			megabytes = atoi(optarg);
+		else
+			return (2);
+	}
+	if (optind != argc - 1 || megabytes < 1)
+		return (fprintf(stderr, "usage: teardown [-m megabytes] microshell\n"), \
+			2);
+	if ((len = readlink("/proc/self/exe", self, sizeof(self) - 1)) == -1)
+		return (perror("teardown"), 2);
+	self[len] = '\0';
+	snprintf(size, sizeof(size), "%d", megabytes);
+	printf("%-10s %12s %12s   (%d MiB producer | head -n 1)\n", "producer", \
+		"off s", "teardown s", megabytes);
+	for (deaf = 0; deaf < 2; deaf++)
+	{
+		pos = 0;
+		line[pos++] = argv[optind];
+		line[pos++] = "--teardown=off";
+		line[pos++] = self;
+		line[pos++] = "--produce";
+		line[pos++] = size;
+		if (deaf)
+			line[pos++] = "--deaf";
+		line[pos++] = "|";
+		line[pos++] = "/usr/bin/head";
+		line[pos++] = "-n";
+		line[pos++] = "1";
+		line[pos] = NULL;
+		off = ft_run(line);
+		line[1] = "--teardown=50";
+		early = ft_run(line);
+		if (off < 0 || early < 0)
+			return (fprintf(stderr, "teardown: run failed\n"), 2);
+		printf("%-10s %12.3f %12.3f\n", deaf ? "deaf" : "plain", off, early);
+	}
+	return (0);
+}
@@ -6,14 +6,645 @@
 /*   By: gicomlan <gicomlan@student.42.fr>          +#+  +:+       +#+        */
 /*                                                +#+#+#+#+#+   +#+           */
 /*   Created: 2024/09/28 09:21:24 by gicomlan          #+#    #+#             */
-/*   Updated: 2024/09/28 09:56:11 by gicomlan         ###   ########.fr       */
+/*   Updated: 2026/10/18 16:40:02 by gicomlan         ###   ########.fr       */
 /*                                                                            */
 /* ************************************************************************** */
 
-#include <unistd.h>     // write, chdir, dup2, close, execve
-#include <sys/wait.h>   // waitpid
-#include <stdlib.h>     // exit
-#include <string.h>     // strcmp
+#define _GNU_SOURCE
+#include <unistd.h>     // write, read, chdir, dup, dup2, close, execve(at)
+#include <sys/wait.h>   // waitpid, wait4
+#include <sys/epoll.h>  // epoll_create1, epoll_ctl, epoll_wait
+#include <sys/resource.h> // getpriority, setpriority, rusage
+#include <sys/time.h>   // timeradd
+#include <sys/socket.h> // socket, bind, listen, accept4, recvmsg, send
+#include <sys/signalfd.h> // signalfd
+#include <sys/un.h>     // sockaddr_un
+#include <sys/stat.h>   // stat, fstat, futimens, mkdir
+#include <sys/file.h>   // flock
+#include <sys/sendfile.h> // sendfile
+#include <sys/mman.h>   // mmap, memfd_create
+#include <sys/syscall.h> // SYS_futex
+#include <linux/futex.h> // FUTEX_WAIT, FUTEX_WAKE
+#include <dirent.h>     // opendir, readdir
+#include <poll.h>       // poll
+#include <signal.h>     // sigprocmask, signal
+#include <fcntl.h>      // pipe2, fcntl, splice, open
+#include <sched.h>      // sched_getaffinity, sched_setaffinity
+#include <pthread.h>    // pthread_create, pthread_join (builtin sort)
+#include <stdio.h>      // snprintf
+#include <stdlib.h>     // exit, malloc, realloc, free, atoi
+#include <string.h>     // strcmp, strncmp, memrchr
+#include <stdint.h>     // uint32_t, uint64_t
+#include <time.h>       // clock_gettime
+#include <errno.h>      // errno
+#if defined(__x86_64__) || defined(__i386__)
+# include <immintrin.h> // _mm(256)_cmpeq_epi8, _mm(256)_movemask_epi8
+#endif
+#include "usdt.h"       // MSH_PROBE1..4 (USDT probes, nops unless traced)
+
+// Kind of token that ends a command
+#define SEP_NONE		0
+#define SEP_PIPE		1
+#define SEP_BREAK		2
+#define SEP_FAN			3
+#define SEP_FAN_LINE	4
+#define SEP_END			5
+
+// Redirection tokens inside a command
+#define REDIR_NONE		0
+#define REDIR_IN		1
+#define REDIR_OUT		2
+#define REDIR_APPEND	3
+#define REDIR_HERE		4
+
+// Rewrites the planner leaves on a command
+#define CMD_EMPTY_IN	1
+#define CMD_NOOP		2
+
+// Bytes moved per splice/read by the fan-in relay
+#define RELAY_CHUNK		65536
+
+// Daemon protocol (keep in sync with tools/msh_client.c)
+#define FRAME_MAGIC		0x3168736Du
+#define FRAME_STDIN		1
+#define FRAME_STDOUT	2
+#define FRAME_STDERR	4
+#define FRAME_MAX		(64 << 20)
+#define STATUS_GROUP	1
+#define STATUS_DONE		2
+#define DAEMON_CLIENTS	256
+#define DAEMON_TIMEOUT	5
+
+// Executables kept open between launches (O_PATH fds)
+#define EXEC_SLOTS		8
+
+// Commands made ready while the one before them runs (--prepare=K), and
+// the fds left free for the stage being launched
+#define PREPARE_AHEAD	4
+#define PREPARE_RESERVE	12
+
+// Trace events kept by --trace (a ring: the oldest are overwritten), and
+// stages tracked at once for their run spans
+#define TRACE_EVENTS	65536
+#define TRACE_LIVE		256
+
+// Parallel map stage (par N cmd...): input cut into line-aligned chunks of
+// about PAR_CHUNK bytes, each run by its own copy of cmd, N at a time
+#define PAR_CHUNK		(1 << 20)
+#define PAR_MAX			64
+
+// Report formats of the time prefix (time [-j] pipeline)
+#define TIME_HUMAN		1
+#define TIME_JSON		2
+
+// Default --teardown: ms the stages upstream of a finished last stage get
+// before SIGTERM (and as much again, plus TEARDOWN_KILL ms, before SIGKILL)
+#define TEARDOWN_MS		50
+#define TEARDOWN_KILL	10
+
+// Latency histograms (--histograms): per argv[0], nanoseconds in buckets
+// of 2^HIST_SUB_BITS steps per power of two (3% wide) up to 2^HIST_TOP ns
+#define HIST_SUB_BITS	5
+#define HIST_TOP		44
+#define HIST_BUCKETS	((HIST_TOP - HIST_SUB_BITS + 1) << HIST_SUB_BITS)
+#define HIST_KEYS		64
+#define HIST_LIVE		256
+#define HIST_SPAWN		0
+#define HIST_RUN		1
+#define HIST_REAP		2
+
+// Resource limits (limit prefix, --limit=): kinds, and how many limited
+// stages can be running at once with their failures still attributed
+#define LIMIT_AS		0
+#define LIMIT_CPU		1
+#define LIMIT_NOFILE	2
+#define LIMIT_NPROC		3
+#define LIMIT_CORE		4
+#define LIMIT_KINDS		5
+#define LIMIT_LIVE		64
+
+// Metrics (--metrics=, --metrics-file=): the counters, how many stage
+// runtime buckets (bounds in g_metric_bounds), how many stages one process
+// times at once, how often the textfile is rewritten (ms) and the largest
+// exposition page
+#define METRIC_COMMANDS		0
+#define METRIC_EXEC_FAILED	1
+#define METRIC_CD_FAILED	2
+#define METRIC_FORKS		3
+#define METRIC_PIPES		4
+#define METRIC_FATAL		5
+#define METRIC_COUNTERS		6
+#define METRIC_BUCKETS		10
+#define METRIC_LIVE			256
+#define METRIC_PERIOD_MS	10000
+#define METRIC_PAGE			8192
+
+// Links of one pipeline that --pipe-stats can instrument
+#define PIPE_LINKS		64
+
+// Ring between two adjacent internal stages: bytes it holds (a power of
+// two), most moved per step, and how often a sleeping side checks that the
+// other one is still alive (ms)
+#define RING_SIZE		(1 << 20)
+#define RING_CHUNK		(1 << 18)
+#define RING_POLL_MS	100
+
+// What an internal stage is (ft_stage_internal), and --ring modes
+#define STAGE_COPY		1
+#define STAGE_MEMORY	2
+#define RING_AUTO		0
+#define RING_ALWAYS		1
+#define RING_OFF		-1
+
+// Builtin grep: bytes per read (GNU grep's first buffer, so a NUL byte
+// makes the input binary at the same point), first buffer, output buffer,
+// and the needle searches --simd can pick
+#define GREP_READ		(96 << 10)
+#define GREP_BUF		(1 << 20)
+#define GREP_OUT		65536
+#define SIMD_AUTO		0
+#define SIMD_SCALAR		1
+#define SIMD_SSE2		2
+#define SIMD_AVX2		3
+
+// Builtin sort: bytes per read, default memory budget (--sort-mem), most
+// threads used unasked and at all (--sort-threads), fewest lines a thread
+// gets, -k keys, run files merged at once, read and output buffers of the
+// merge, and the workers' stack
+#define SORT_READ		(128 << 10)
+#define SORT_MEM		(256LL << 20)
+#define SORT_THREADS	8
+#define SORT_PARTS		64
+#define SORT_SMALL		4096
+#define SORT_KEYS		8
+#define SORT_FANIN		64
+#define SORT_RUN_BUF	(64 << 10)
+#define SORT_OUT		65536
+#define SORT_STACK		(256 << 10)
+
+// Memoization cache (cache prefix, --cache-*)
+#define CACHE_MAGIC		0x3165686Du
+#define CACHE_SIZE		(256LL << 20)
+
+// Stage placement policies (--placement=)
+#define PLACE_NONE		0
+#define PLACE_COMPACT	1
+#define PLACE_CACHE		2
+#define PLACE_SPREAD	3
+
+// Topology key levels, from the widest domain to the narrowest
+#define KEY_L3			0
+#define KEY_L2			1
+#define KEY_CORE		2
+
+// Limits for one stage: value[kind] counts when bit kind of set is on
+typedef struct s_limits
+{
+	int		set;
+	rlim_t	value[LIMIT_KINDS];
+}	t_limits;
+
+// Single-producer single-consumer byte ring in a memfd both stages map;
+// head and tail count bytes modulo 2^32, each side on its own cache line.
+// A side with nothing to do sleeps on the futex word (data_seq, space_seq)
+// the other one bumps after each step, and after done or gone
+typedef struct s_ring
+{
+	uint32_t	head;
+	uint32_t	done;
+	uint32_t	data_seq;
+	uint32_t	data_wait;
+	pid_t		producer;
+	uint32_t	tail __attribute__((aligned(64)));
+	uint32_t	gone;
+	uint32_t	space_seq;
+	uint32_t	space_wait;
+	pid_t		consumer;
+	char		data[RING_SIZE] __attribute__((aligned(64)));
+}	t_ring;
+
+// Options, plus where the next stage sits; children inherit it over fork
+typedef struct s_shell
+{
+	int		placement;
+	int		boost;
+	int		job;
+	int		slot;
+	int		depth;
+	char	*daemon;
+	int		jobs;
+	int		status_fd;
+	char	*cache_dir;
+	long long	cache_size;
+	int		cache_stats;
+	int		no_optimize;
+	int		dump_plan;
+	int		no_exec_cache;
+	int		prepare;
+	int		prepared;
+	int		left;
+	int		pipe_stats;
+	char	*trace;
+	int64_t	born;
+	int		stdin_copy;
+	int		capture_fd;
+	int		entry_fd;
+	pid_t	tee_pid;
+	int		tee_status;
+	int		timing;
+	int		time_stages;
+	int64_t	time_start;
+	struct rusage	time_usage;
+	int		teardown;
+	pid_t	pgid;
+	int		tty;
+	int		histograms;
+	int		hist_slot;
+	int64_t	spawn_start;
+	t_limits	limits;
+	t_limits	stage_limits;
+	char	*limit_error;
+	int		ring;
+	int		simd;
+	int		c_locale;
+	long long	sort_mem;
+	int		sort_threads;
+	char	*metrics;
+	char	*metrics_file;
+	t_ring	*ring_in;
+	t_ring	*ring_out;
+	char	entry[4096];
+}	t_shell;
+
+// One CPU and the first CPU of each domain it belongs to
+typedef struct s_cpu
+{
+	int		id;
+	int		key[KEY_CORE + 1];
+}	t_cpu;
+
+// Allowed CPUs sorted so SMT siblings, then L2 and L3 neighbours, are adjacent
+typedef struct s_topology
+{
+	int		count;
+	int		domains[KEY_CORE + 1];
+	t_cpu	cpu[CPU_SETSIZE];
+}	t_topology;
+
+// An executable already launched: an O_PATH fd on it, and whether it must
+// still be launched by path (shebang scripts, symlinks)
+typedef struct s_exec
+{
+	char		*path;
+	int			fd;
+	int			by_path;
+	unsigned	used;
+}	t_exec;
+
+t_shell		g_shell;
+t_topology	g_topology;
+t_exec		g_exec[EXEC_SLOTS];
+
+// One command of the line: its tokens and the separator that ends it
+typedef struct s_command
+{
+	char	**arg;
+	int		count;
+	short	sep;
+	char	fan_in;
+	char	flags;
+}	t_command;
+
+// A close-on-exec pipe created ahead for a command that pipes
+typedef struct s_prepared
+{
+	t_command	*cmd;
+	int			fds[2];
+}	t_prepared;
+
+t_prepared	g_prepared[PREPARE_AHEAD];
+
+// A builtin grep stage: its pattern (folded with -i) where any[i] marks a
+// "." and ^/$ anchor it, the longest literal run of it (the needle the
+// vector search looks for), its flags, and what it has seen so far
+typedef struct s_grep
+{
+	char	*pat;
+	char	*any;
+	int		len;
+	int		start;
+	int		end;
+	int		needle;
+	int		needle_len;
+	int		icase;
+	int		invert;
+	int		count;
+	int		binary;
+	int		selected;
+	long long	matched;
+	long long	lines;
+	char	*name;
+	char	*out;
+	size_t	out_len;
+	size_t	(*find)(struct s_grep *, const char *, size_t);
+}	t_grep;
+
+// A sort key (-k): fields and characters counted from 0 as GNU sort does
+// (end char 0 takes the whole end field; to_end runs to the end of the
+// line) and its own b/n/r, or the global ones when it has none of them
+typedef struct s_key
+{
+	size_t	sword;
+	size_t	schar;
+	size_t	eword;
+	size_t	echar;
+	char	to_end;
+	char	skip_start;
+	char	skip_end;
+	char	numeric;
+	char	reverse;
+}	t_key;
+
+// A builtin sort stage: its keys, -t (-1 splits on blanks), flags, budget,
+// and the arena the lines of the current chunk sit in
+typedef struct s_sort
+{
+	t_key		key[SORT_KEYS];
+	int			keys;
+	int			tab;
+	int			numeric;
+	int			reverse;
+	int			unique;
+	int			threads;
+	size_t		mem;
+	char		*name;
+	char		*tmpdir;
+	char		*base;
+}	t_sort;
+
+// One input line: where it and its first key start in the arena, their
+// lengths (the line's without '\n'), and an 8-byte prefix that orders as
+// the first key does (ft_sort_prefix), so most comparisons stay in here
+typedef struct s_line
+{
+	size_t		off;
+	size_t		len;
+	size_t		key;
+	size_t		key_len;
+	uint64_t	prefix;
+}	t_line;
+
+// A line as the comparison sees it: its text and its first key's span,
+// found once per line (as GNU sort does) rather than once per comparison
+typedef struct s_view
+{
+	const char	*text;
+	size_t		len;
+	const char	*key;
+	const char	*lim;
+}	t_view;
+
+// What one thread sorts: a slice of the lines and the same slice of scratch
+typedef struct s_part
+{
+	t_sort		*sort;
+	t_line		*line;
+	t_line		*tmp;
+	size_t		count;
+	pthread_t	thread;
+	int			started;
+}	t_part;
+
+// One input of a merge: a sorted slice in memory (fd -1) or a run file read
+// through buf; view is its current line until done
+typedef struct s_source
+{
+	int		fd;
+	t_line	*line;
+	t_line	*end;
+	char	*buf;
+	size_t	cap;
+	size_t	start;
+	size_t	fill;
+	int		eof;
+	t_view	view;
+	int		done;
+}	t_source;
+
+// Where sorted lines go: a run file, or the stage's output (fd -1); with -u
+// the last line output is kept to drop the ones equal to it
+typedef struct s_sink
+{
+	int		fd;
+	char	*buf;
+	size_t	len;
+	char	*last;
+	size_t	last_cap;
+	t_view	last_view;
+	int		has_last;
+}	t_sink;
+
+// What the relay of one instrumented link saw, in shared memory (ns)
+typedef struct s_link
+{
+	uint64_t	bytes;
+	uint64_t	chunks;
+	int64_t		starved;
+	int64_t		blocked;
+	int64_t		elapsed;
+}	t_link;
+
+t_link		*g_links;
+
+// One trace event; name and arg point into memory every process shares
+// (string literals, the command line), so children can record them too
+typedef struct s_event
+{
+	const char	*name;
+	const char	*arg;
+	int64_t		ts;
+	int64_t		value;
+	int32_t		tid;
+	char		ph;
+}	t_event;
+
+// Event ring in a shared mapping, written by the shell and its children
+typedef struct s_trace
+{
+	uint32_t	count;
+	int32_t		pid;
+	int32_t		fds;
+	int32_t		children;
+	t_event		events[TRACE_EVENTS];
+}	t_trace;
+
+// A stage the shell forked and has not reaped yet
+typedef struct s_live
+{
+	pid_t		pid;
+	int64_t		start;
+	const char	*arg;
+}	t_live;
+
+t_trace		*g_trace;
+t_live		g_live[TRACE_LIVE];
+
+// One latency distribution; updated with atomics by the shell and children
+typedef struct s_hist
+{
+	uint64_t	count;
+	uint64_t	max;
+	uint64_t	bucket[HIST_BUCKETS];
+}	t_hist;
+
+// Spawn, run and reap latency of one argv[0]
+typedef struct s_hist_key
+{
+	char	name[64];
+	t_hist	metric[3];
+}	t_hist_key;
+
+// A stage being timed: the child stamps exec_ns, SIGCHLD stamps exit_ns
+typedef struct s_hist_live
+{
+	pid_t	pid;
+	int		key;
+	int64_t	exec_ns;
+	int64_t	exit_ns;
+}	t_hist_live;
+
+// Every histogram, in one shared mapping made before the first fork (so
+// daemon workers add to the same ones)
+typedef struct s_hists
+{
+	int			keys;
+	char		lock;
+	t_hist_live	live[HIST_LIVE];
+	t_hist_key	key[HIST_KEYS];
+}	t_hists;
+
+t_hists		*g_hists;
+
+// One counter, alone on its cache line so that processes bumping
+// different counters at once never share one
+typedef struct s_counter
+{
+	uint64_t	value __attribute__((aligned(64)));
+}	t_counter;
+
+// Every metric, in one shared mapping made before the first fork (so
+// stages, their children and daemon workers all count into it, lock-free)
+typedef struct s_metrics
+{
+	t_counter	counter[METRIC_COUNTERS];
+	uint64_t	bucket[METRIC_BUCKETS + 1] __attribute__((aligned(64)));
+	uint64_t	runs;
+	uint64_t	run_ns;
+	pid_t		shell;
+}	t_metrics;
+
+// A stage this process forked, timed until this process reaps it
+typedef struct s_metric_live
+{
+	pid_t	pid;
+	int64_t	start;
+}	t_metric_live;
+
+static const int64_t	g_metric_bounds[METRIC_BUCKETS] = {1000000LL, \
+	5000000LL, 10000000LL, 50000000LL, 100000000LL, 500000000LL, \
+	1000000000LL, 5000000000LL, 10000000000LL, 60000000000LL};
+
+t_metrics		*g_metrics;
+t_metric_live	g_metric_live[METRIC_LIVE];
+
+// A running stage that has limits, kept to explain its failure at reap
+typedef struct s_limited
+{
+	pid_t		pid;
+	const char	*arg;
+	t_limits	limits;
+}	t_limited;
+
+t_limited	g_limited[LIMIT_LIVE];
+
+// Request a daemon client sends: argc then envc NUL-terminated strings follow
+// (length bytes), the fds flagged in fds ride along as SCM_RIGHTS
+typedef struct s_request
+{
+	uint32_t	magic;
+	uint32_t	argc;
+	uint32_t	envc;
+	uint32_t	fds;
+	uint32_t	length;
+}	t_request;
+
+// Frame the daemon streams back: one per finished group, then one done
+typedef struct s_status
+{
+	uint32_t	magic;
+	int32_t		kind;
+	int32_t		code;
+}	t_status;
+
+// One connected daemon client and the worker serving it (0 when idle)
+typedef struct s_client
+{
+	int		fd;
+	pid_t	worker;
+}	t_client;
+
+// Header of a cache entry file, the cached stdout follows it
+typedef struct s_cache_entry
+{
+	uint32_t	magic;
+	int32_t		code;
+	uint64_t	length;
+}	t_cache_entry;
+
+// Counters kept in <cache dir>/stats, shared by every microshell
+typedef struct s_cache_stats
+{
+	uint64_t	hits;
+	uint64_t	misses;
+	uint64_t	stores;
+	uint64_t	evictions;
+	int64_t		bytes;
+}	t_cache_stats;
+
+// Running SHA-256 used for cache keys
+typedef struct s_sha256
+{
+	uint32_t		state[8];
+	uint64_t		length;
+	unsigned char	block[64];
+}	t_sha256;
+
+// One chunk of a par stage in flight: its input, still to be written to
+// its copy, and the output the copy made before the chunk's turn came
+typedef struct s_par_slot
+{
+	pid_t		pid;
+	uint64_t	seq;
+	int			in;
+	int			out;
+	char		*data;
+	size_t		len;
+	size_t		off;
+	char		*buf;
+	size_t		buf_len;
+	size_t		buf_cap;
+}	t_par_slot;
+
+// One producer of a fan-in group, as seen by the relay
+typedef struct s_producer
+{
+	int		fd;
+	pid_t	pid;
+	int		eof;
+	char	*buf;
+	size_t	len;
+	size_t	cap;
+}	t_producer;
 
 // Function to print an error msg to stderr
 void ft_print_error(char *msg)
@@ -22,67 +653,4332 @@ void ft_print_error(char *msg)
 		write(STDERR_FILENO, msg++, 1);
 }
 
+// Function to count one event: a relaxed atomic add to a counter on its
+// own cache line, or nothing at all without metrics
+static inline void ft_metric(int counter)
+{
+	if (g_metrics)
+		__atomic_fetch_add(&g_metrics->counter[counter].value, 1, \
+			__ATOMIC_RELAXED);
+}
+
+// Function to fork, counting the process for the metrics
+pid_t ft_fork(void)
+{
+	pid_t pid = fork();
+
+	if (pid > 0)
+		ft_metric(METRIC_FORKS);
+	return (pid);
+}
+
+// Function to report a failed system call and leave
+void ft_exit_fatal(void)
+{
+	ft_metric(METRIC_FATAL);
+	ft_print_error("error: fatal\n");
+	exit(EXIT_FAILURE);
+}
+
+// Function to read the monotonic clock in nanoseconds
+int64_t ft_clock_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1000000000LL + ts.tv_nsec);
+}
+
+// Function to record a trace event in the ring; no allocation, no syscall
+void ft_trace(char ph, const char *name, pid_t tid, int64_t ts, \
+	int64_t value, const char *arg)
+{
+	uint32_t slot;
+
+	if (!g_trace)
+		return ;
+	slot = __atomic_fetch_add(&g_trace->count, 1, __ATOMIC_RELAXED);
+	g_trace->events[slot % TRACE_EVENTS] = \
+		(t_event){name, arg, ts, value, tid, ph};
+}
+
+// Function to move one of the shell's counters and record its new value
+void ft_trace_count(int32_t *counter, int delta, const char *name)
+{
+	if (!g_trace)
+		return ;
+	*counter += delta;
+	ft_trace('C', name, g_trace->pid, ft_clock_ns(), *counter, NULL);
+}
+
+// Function to note a forked stage: its fork span, and the start of its run
+void ft_trace_fork(pid_t pid, int64_t start, const char *arg)
+{
+	int64_t now;
+	int index;
+
+	if (!g_trace)
+		return ;
+	now = ft_clock_ns();
+	ft_trace('X', "fork", pid, start, now - start, NULL);
+	for (index = 0; index < TRACE_LIVE && g_live[index].pid; index++)
+		;
+	if (index < TRACE_LIVE)
+		g_live[index] = (t_live){pid, now, arg};
+	ft_trace_count(&g_trace->children, 1, "children");
+}
+
+// Function to note a reaped stage: its whole run span and the reap itself
+void ft_trace_reap(pid_t pid, int64_t wait_start)
+{
+	int64_t now;
+	int index;
+
+	if (!g_trace || pid <= 0)
+		return ;
+	for (index = 0; index < TRACE_LIVE && g_live[index].pid != pid; index++)
+		;
+	if (index == TRACE_LIVE)
+		return ;
+	now = ft_clock_ns();
+	ft_trace('X', "run", pid, g_live[index].start, \
+		now - g_live[index].start, g_live[index].arg);
+	ft_trace('X', "reap", pid, wait_start, now - wait_start, NULL);
+	g_live[index].pid = 0;
+	ft_trace_count(&g_trace->children, -1, "children");
+}
+
+// Function to print a string as a JSON string
+void ft_json_string(FILE *out, const char *str)
+{
+	fputc('"', out);
+	for (; *str; str++)
+	{
+		if (*str == '"' || *str == '\\')
+			fprintf(out, "\\%c", *str);
+		else if ((unsigned char)*str < 0x20)
+			fprintf(out, "\\u%04x", *str);
+		else
+			fputc(*str, out);
+	}
+	fputc('"', out);
+}
+
+// Function to write the ring as Chrome trace-event JSON, oldest first;
+// every stage gets its own track, named after its command
+void ft_trace_flush(void)
+{
+	t_event *ev;
+	FILE *out;
+	uint32_t index, first;
+
+	if (!g_trace || !(out = fopen(g_shell.trace, "we")))
+		return ;
+	first = g_trace->count > TRACE_EVENTS ? g_trace->count - TRACE_EVENTS : 0;
+	fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n" \
+		"{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":%d,\"tid\":%d," \
+		"\"args\":{\"name\":\"microshell\"}}", g_trace->pid, g_trace->pid);
+	for (index = first; index < g_trace->count; index++)
+	{
+		ev = &g_trace->events[index % TRACE_EVENTS];
+		fprintf(out, ",\n{\"ph\":\"%c\",\"name\":\"%s\",\"pid\":%d," \
+			"\"tid\":%d,\"ts\":%.3f", ev->ph, ev->name, g_trace->pid, ev->tid, \
+			ev->ts / 1e3);
+		if (ev->ph == 'X')
+			fprintf(out, ",\"dur\":%.3f", ev->value / 1e3);
+		if (ev->ph == 'C')
+			fprintf(out, ",\"args\":{\"%s\":%lld}", ev->name, \
+				(long long)ev->value);
+		if (ev->ph == 'i')
+			fprintf(out, ",\"s\":\"t\",\"args\":{\"%s\":%lld}", \
+				strcmp(ev->name, "limit") ? "fd" : "code", \
+				(long long)ev->value);
+		fputc('}', out);
+		if (ev->arg)
+		{
+			fprintf(out, ",\n{\"ph\":\"M\",\"name\":\"thread_name\"," \
+				"\"pid\":%d,\"tid\":%d,\"args\":{\"name\":", g_trace->pid, \
+				ev->tid);
+			ft_json_string(out, ev->arg);
+			fputs("}}", out);
+		}
+	}
+	fputs("\n]}\n", out);
+	fclose(out);
+}
+
+// Function to tell which separator (if any) a token is
+int ft_separator(char *token)
+{
+	if (!token)
+		return (SEP_END);
+	if (!strcmp(token, "|"))
+		return (SEP_PIPE);
+	if (!strcmp(token, ";"))
+		return (SEP_BREAK);
+	if (!strcmp(token, "&"))
+		return (SEP_FAN);
+	if (!strcmp(token, "&~"))
+		return (SEP_FAN_LINE);
+	return (SEP_NONE);
+}
+
+// Function to flag, in up to 64 first bytes, those that can start a separator
+uint64_t ft_match_separators(const unsigned char *first, int count)
+{
+	uint64_t mask = 0;
+	int index = 0;
+
+#if defined(__AVX2__)
+	__m256i v, hit;
+	for (; index + 32 <= count; index += 32)
+	{
+		v = _mm256_loadu_si256((const __m256i *)(first + index));
+		hit = _mm256_or_si256(_mm256_or_si256(\
+			_mm256_cmpeq_epi8(v, _mm256_set1_epi8('|')), \
+			_mm256_cmpeq_epi8(v, _mm256_set1_epi8(';'))), \
+			_mm256_cmpeq_epi8(v, _mm256_set1_epi8('&')));
+		mask |= (uint64_t)(uint32_t)_mm256_movemask_epi8(hit) << index;
+	}
+#elif defined(__SSE2__)
+	__m128i v, hit;
+	for (; index + 16 <= count; index += 16)
+	{
+		v = _mm_loadu_si128((const __m128i *)(first + index));
+		hit = _mm_or_si128(_mm_or_si128(\
+			_mm_cmpeq_epi8(v, _mm_set1_epi8('|')), \
+			_mm_cmpeq_epi8(v, _mm_set1_epi8(';'))), \
+			_mm_cmpeq_epi8(v, _mm_set1_epi8('&')));
+		mask |= (uint64_t)(uint16_t)_mm_movemask_epi8(hit) << index;
+	}
+#endif
+	for (; index < count; index++)
+		mask |= (uint64_t)(first[index] == '|' || first[index] == ';' || \
+			first[index] == '&') << index;
+	return (mask);
+}
+
+// Function to confirm a candidate with its next bytes, SEP_NONE if not one
+int ft_confirm_separator(const char *token)
+{
+	if (!token[1])
+		return (token[0] == '|' ? SEP_PIPE : token[0] == ';' ? SEP_BREAK \
+			: SEP_FAN);
+	if (token[0] == '&' && token[1] == '~' && !token[2])
+		return (SEP_FAN_LINE);
+	return (SEP_NONE);
+}
+
+// Function to append a command to the index, growing it as needed
+void ft_push_command(t_command **commands, int *n, t_command cmd)
+{
+	if (!(*n & (*n - 1)) && *n >= 16 && \
+		!(*commands = realloc(*commands, sizeof(t_command) * *n * 2)))
+		ft_exit_fatal();
+	(*commands)[(*n)++] = cmd;
+}
+
+// Function to cut the line into commands in one pass: the first bytes of
+// each block of 64 tokens are matched into a candidate bitmap, whose set
+// bits are confirmed and walked; fan-in producers stay inside their command
+t_command *ft_build_index(char **argv, int count, int *total)
+{
+	unsigned char first[64];
+	uint64_t bitmap;
+	t_command *commands;
+	int base, block, index, pos, sep, start = 0, fan_in = 0, n = 0;
+
+	if (!(commands = malloc(sizeof(t_command) * 16)))
+		ft_exit_fatal();
+	for (base = 0; base < count; base += 64)
+	{
+		block = count - base < 64 ? count - base : 64;
+		for (index = 0; index < block; index++)
+			first[index] = argv[base + index][0];
+		for (bitmap = ft_match_separators(first, block); bitmap; \
+			bitmap &= bitmap - 1)
+		{
+			pos = base + __builtin_ctzll(bitmap);
+			if ((sep = ft_confirm_separator(argv[pos])) == SEP_NONE)
+				continue ;
+			fan_in |= (sep == SEP_FAN || sep == SEP_FAN_LINE);
+			if (sep == SEP_FAN || sep == SEP_FAN_LINE)
+				continue ;
+			ft_push_command(&commands, &n, \
+				(t_command){argv + start, pos - start, sep, fan_in, 0});
+			start = pos + 1;
+			fan_in = 0;
+		}
+	}
+	ft_push_command(&commands, &n, \
+		(t_command){argv + start, count - start, SEP_END, fan_in, 0});
+	*total = n;
+	return (commands);
+}
+
+// Function to tell which redirection (if any) a token is
+int ft_redirection(char *token)
+{
+	if (token[0] == '<' && !token[1])
+		return (REDIR_IN);
+	if (token[0] == '>' && !token[1])
+		return (REDIR_OUT);
+	if (token[0] == '>' && token[1] == '>' && !token[2])
+		return (REDIR_APPEND);
+	if (!strcmp(token, "<<<"))
+		return (REDIR_HERE);
+	return (REDIR_NONE);
+}
+
+// Function to fold an ASCII letter to lower case, as grep -i does in the
+// C locale; every other byte stays as it is
+static inline unsigned char ft_lower(unsigned char c)
+{
+	return ((unsigned)(c - 'A') < 26 ? c | 0x20 : c);
+}
+
+// Function to read a pattern into g (NULL only checks it): with -F every
+// byte is literal; otherwise a BRE made of literals, ".", "\" before one
+// of .[]*^$\, a leading "^" and a trailing "$". Anything else ([], *,
+// \(...\), several patterns) returns 0 and is left to the real grep
+int ft_grep_pattern(char *p, int fixed, t_grep *g)
+{
+	int index = 0, len = 0, literal, run = 0;
+	char any;
+
+	if (g && (!(g->pat = malloc(strlen(p) + 1)) || \
+		!(g->any = malloc(strlen(p) + 1))))
+		ft_exit_fatal();
+	if (!fixed && *p == '^' && (index = 1) && g)
+		g->start = 1;
+	for (; p[index]; index++)
+	{
+		any = !fixed && p[index] == '.';
+		if (p[index] == '\n' || (!fixed && (p[index] == '[' || \
+			p[index] == '*')))
+			return (0);
+		if (!fixed && p[index] == '$' && !p[index + 1])
+			return (g ? (g->end = 1) : 1);
+		if (!fixed && p[index] == '\\' && (!p[++index] || \
+			!strchr(".[]*^$\\", p[index])))
+			return (0);
+		if (g)
+			g->pat[len] = g->icase ? ft_lower(p[index]) : p[index], \
+			g->any[len] = any;
+		if (g && (literal = !any) && ++run > g->needle_len)
+			g->needle_len = run, g->needle = len + 1 - run;
+		else if (g && !literal)
+			run = 0;
+		len++;
+		if (g)
+			g->len = len;
+	}
+	return (1);
+}
+
+// Function to tell whether a stage is a grep the builtin runs, reading its
+// flags and pattern into g when given; redirections are skipped. Bare
+// "grep" is the builtin, and /usr/bin/grep or /bin/grep is too in the C
+// locale (where its output is the same) unless --no-optimize
+int ft_grep_args(char **arg, int arg_count, t_grep *g)
+{
+	char *pattern = NULL, *word = NULL, *flag;
+	int index, dashdash = 0, fixed = 0, icase = 0;
+
+	for (index = 0; index < arg_count; index++)
+	{
+		if (ft_redirection(arg[index]) && ++index)
+			continue ;
+		if (!word && (word = arg[index]))
+			continue ;
+		if (dashdash || arg[index][0] != '-' || !arg[index][1])
+		{
+			if (pattern)
+				return (0);
+			pattern = arg[index];
+			continue ;
+		}
+		if (!strcmp(arg[index], "--") && (dashdash = 1))
+			continue ;
+		for (flag = arg[index] + 1; *flag; flag++)
+		{
+			if (!strchr("vciF", *flag))
+				return (0);
+			fixed |= *flag == 'F';
+			icase |= *flag == 'i';
+			if (g)
+				g->invert |= *flag == 'v', g->count |= *flag == 'c';
+		}
+	}
+	if (!word || !pattern || (strcmp(word, "grep") && (g_shell.no_optimize \
+		|| !g_shell.c_locale || (strcmp(word, "/usr/bin/grep") && \
+		strcmp(word, "/bin/grep")))))
+		return (0);
+	if (g)
+		g->icase = icase;
+	return (ft_grep_pattern(pattern, fixed, g));
+}
+
+// Function to read one -k position, F[.C] then its b/n/r letters, into
+// field and offset (counted from 1; offset is dflt without ".C"); returns
+// what follows it, NULL where GNU sort would fail or the builtin can't go
+char *ft_sort_position(char *spec, size_t *field, size_t *offset, \
+	size_t dflt, t_key *key, int end)
+{
+	size_t *count = field;
+
+	*field = 0, *offset = dflt;
+	while (count)
+	{
+		if ((unsigned)(*spec - '0') > 9)
+			return (NULL);
+		for (*count = 0; (unsigned)(*spec - '0') <= 9; spec++)
+			if ((*count = *count * 10 + *spec - '0') > 1000000000)
+				return (NULL);
+		count = count == field && *spec == '.' && spec++ ? offset : NULL;
+	}
+	for (; *spec && *spec != ','; spec++)
+	{
+		if (!strchr("bnr", *spec))
+			return (NULL);
+		if (*spec == 'b' && end)
+			key->skip_end = 1;
+		else if (*spec == 'b')
+			key->skip_start = 1;
+		key->numeric |= *spec == 'n';
+		key->reverse |= *spec == 'r';
+	}
+	return (spec);
+}
+
+// Function to read a -k spec (POS1[,POS2]) into key, returns 0 if it is
+// not one the builtin takes
+int ft_sort_key(char *spec, t_key *key)
+{
+	size_t field, offset;
+
+	*key = (t_key){0};
+	if (!(spec = ft_sort_position(spec, &field, &offset, 1, key, 0)) || \
+		!field || !offset)
+		return (0);
+	key->sword = field - 1, key->schar = offset - 1, key->to_end = !*spec;
+	if (!*spec)
+		return (1);
+	if (!(spec = ft_sort_position(spec + 1, &field, &offset, 0, key, 1)) \
+		|| *spec || !field)
+		return (0);
+	key->eword = field - 1, key->echar = offset;
+	return (1);
+}
+
+// Function to tell whether a stage is a sort the builtin runs (options -n
+// -r -u -t -k on stdin, any stage word as for grep), reading it into s
+// when given. A key with none of b/n/r takes the global -n and -r, and
+// -n alone sorts on a key spanning the line, as in GNU sort
+int ft_sort_args(char **arg, int arg_count, t_sort *s)
+{
+	t_sort parsed = {.tab = -1};
+	char *word = NULL, *flag, *value;
+	int index, dashdash = 0;
+	t_key *key;
+
+	for (index = 0; index < arg_count; index++)
+	{
+		if (ft_redirection(arg[index]) && ++index)
+			continue ;
+		if (!word && (word = arg[index]))
+			continue ;
+		if (dashdash || arg[index][0] != '-' || !arg[index][1])
+			return (0);
+		if (!strcmp(arg[index], "--") && (dashdash = 1))
+			continue ;
+		for (flag = arg[index] + 1; *flag; flag++)
+		{
+			if (*flag == 'k' || *flag == 't')
+			{
+				if (!(value = flag[1] ? flag + 1 : index + 1 < arg_count \
+					&& !ft_redirection(arg[index + 1]) ? arg[++index] : NULL))
+					return (0);
+				if (*flag == 't' && (!*value || value[1] || (parsed.tab != -1 \
+					&& parsed.tab != (unsigned char)*value)))
+					return (0);
+				if (*flag == 't')
+					parsed.tab = (unsigned char)*value;
+				else if (parsed.keys == SORT_KEYS || \
+					!ft_sort_key(value, &parsed.key[parsed.keys++]))
+					return (0);
+				break ;
+			}
+			if (!strchr("nru", *flag))
+				return (0);
+			parsed.numeric |= *flag == 'n';
+			parsed.reverse |= *flag == 'r';
+			parsed.unique |= *flag == 'u';
+		}
+	}
+	if (!word || (strcmp(word, "sort") && (g_shell.no_optimize || \
+		!g_shell.c_locale || (strcmp(word, "/usr/bin/sort") && \
+		strcmp(word, "/bin/sort")))))
+		return (0);
+	for (key = parsed.key; key < parsed.key + parsed.keys; key++)
+		if (!(key->skip_start | key->skip_end | key->numeric | key->reverse))
+			key->numeric = parsed.numeric, key->reverse = parsed.reverse;
+	if (!parsed.keys && parsed.numeric)
+		parsed.key[parsed.keys++] = (t_key){.to_end = 1, .numeric = 1, \
+			.reverse = parsed.reverse};
+	if (s)
+		*s = parsed, s->name = word;
+	return (1);
+}
+
+// Function to tell whether a stage runs one of the builtin filters
+int ft_builtin_stage(char **arg, int arg_count)
+{
+	return (ft_grep_args(arg, arg_count, NULL) || \
+		ft_sort_args(arg, arg_count, NULL));
+}
+
+// Function to forget a cached executable
+void ft_exec_drop(t_exec *slot)
+{
+	close(slot->fd);
+	if (g_trace)
+		ft_trace_count(&g_trace->fds, -1, "fds");
+	free(slot->path);
+	*slot = (t_exec){NULL, -1, 0, 0};
+}
+
+// Function to find path among the cached executables, without a syscall
+t_exec *ft_exec_find(char *path)
+{
+	int index;
+
+	for (index = 0; index < EXEC_SLOTS; index++)
+		if (g_exec[index].path && !strcmp(g_exec[index].path, path))
+			return (&g_exec[index]);
+	return (NULL);
+}
+
+// Function to make sure path is in the exec cache before it is launched;
+// an entry whose file lost its last link (deleted, or replaced by rename)
+// is reopened, a new one takes the least recently used slot
+void ft_exec_cache(char *path)
+{
+	static unsigned clock;
+	t_exec *slot;
+	struct stat st;
+	char magic[2];
+	int fd, index;
+
+	if ((slot = ft_exec_find(path)) && !fstat(slot->fd, &st) && st.st_nlink)
+		return ((void)(slot->used = ++clock));
+	if (slot)
+		ft_exec_drop(slot);
+	if ((fd = open(path, O_PATH | O_NOFOLLOW | O_CLOEXEC)) == -1)
+		return ;
+	if (g_trace)
+		ft_trace_count(&g_trace->fds, 1, "fds");
+	slot = &g_exec[0];
+	for (index = 1; index < EXEC_SLOTS; index++)
+		if (g_exec[index].used < slot->used)
+			slot = &g_exec[index];
+	if (slot->path)
+		ft_exec_drop(slot);
+	if (!(slot->path = strdup(path)))
+		ft_exit_fatal();
+	slot->fd = fd;
+	slot->used = ++clock;
+	slot->by_path = fstat(fd, &st) || !S_ISREG(st.st_mode);
+	if (!slot->by_path && (fd = open(path, O_RDONLY | O_CLOEXEC)) != -1)
+	{
+		slot->by_path = read(fd, magic, 2) == 2 && !memcmp(magic, "#!", 2);
+		close(fd);
+	}
+}
+
+// Function to tell whether the fd limit leaves room for one more pipe
+int ft_fd_room(void)
+{
+	struct rlimit limit;
+	int lowest;
+
+	if (getrlimit(RLIMIT_NOFILE, &limit) == -1 || \
+		(lowest = fcntl(STDIN_FILENO, F_DUPFD_CLOEXEC, 0)) == -1)
+		return (0);
+	close(lowest);
+	return ((rlim_t)lowest + 2 + PREPARE_RESERVE <= limit.rlim_cur);
+}
+
+// Function to get the next commands ready while the current one runs:
+// their executables into the exec cache, and a pipe for each that pipes
+void ft_prepare(t_command *next, int left)
+{
+	t_prepared *ready;
+	t_command *cmd;
+	int index, known;
+
+	for (index = 0; index < left && index < g_shell.prepare; index++)
+	{
+		cmd = &next[index];
+		if (!cmd->count || cmd->fan_in || (cmd->flags & CMD_NOOP) || \
+			!strcmp(*cmd->arg, "cd") || !strcmp(*cmd->arg, "cache") || \
+			!strcmp(*cmd->arg, "par") || !strcmp(*cmd->arg, "time") || \
+			!strcmp(*cmd->arg, "limit") || ft_redirection(*cmd->arg) || \
+			ft_builtin_stage(cmd->arg, cmd->count))
+			continue ;
+		if (!g_shell.no_exec_cache)
+			ft_exec_cache(*cmd->arg);
+		for (known = 0; known < g_shell.prepared; known++)
+			if (g_prepared[known].cmd == cmd)
+				break ;
+		ready = &g_prepared[g_shell.prepared];
+		if (cmd->sep == SEP_PIPE && known == g_shell.prepared && \
+			g_shell.prepared < PREPARE_AHEAD && ft_fd_room() && \
+			pipe2(ready->fds, O_CLOEXEC) == 0)
+			ready->cmd = cmd, g_shell.prepared++;
+	}
+}
+
+// Function to hand out the pipe prepared for cmd, 0 if there is none; the
+// ones left behind by commands that never ran (cache hits) are closed
+int ft_take_pipe(t_command *cmd, int *pipe_fds)
+{
+	int index = 0, found = 0;
+
+	while (index < g_shell.prepared)
+	{
+		if (g_prepared[index].cmd > cmd)
+		{
+			index++;
+			continue ;
+		}
+		if (g_prepared[index].cmd == cmd)
+			pipe_fds[0] = g_prepared[index].fds[0], \
+			pipe_fds[1] = g_prepared[index].fds[1], found = 1;
+		else
+			close(g_prepared[index].fds[0]), close(g_prepared[index].fds[1]);
+		g_prepared[index] = g_prepared[--g_shell.prepared];
+	}
+	return (found);
+}
+
+// Function to close every prepared pipe: at the end of a line, and in
+// children that never exec (they would hold a future pipe open)
+void ft_drop_prepared(void)
+{
+	while (g_shell.prepared--)
+		close(g_prepared[g_shell.prepared].fds[0]), \
+		close(g_prepared[g_shell.prepared].fds[1]);
+	g_shell.prepared = 0;
+}
+
 // Function to change directory
 int ft_execute_cd(char **arg, int arg_count)
 {
+	int index, failed;
+
 	if (arg_count != 2)
-		return (ft_print_error("error: cd: bad arg\n"), 1);
-	if (chdir(arg[1]) == -1)
-		return (ft_print_error("error: cd: cannot change directory to "), \
+		return (ft_metric(METRIC_CD_FAILED), \
+			ft_print_error("error: cd: bad arg\n"), 1);
+	failed = chdir(arg[1]) == -1;
+	MSH_PROBE2(cd, arg[1], failed);
+	if (failed)
+		return (ft_metric(METRIC_CD_FAILED), \
+			ft_print_error("error: cd: cannot change directory to "), \
 			ft_print_error(arg[1]), ft_print_error("\n"), 1);
+	for (index = 0; index < EXEC_SLOTS; index++)
+		if (g_exec[index].path && *g_exec[index].path != '/')
+			ft_exec_drop(&g_exec[index]);
 	return (0);
 }
 
-// Function to set up a pipe if needed
-void ft_configure_pipe(int has_pipe, int *pipe_fds, int end)
+// Function to write a whole buffer, retrying short writes
+void ft_write_all(int fd, char *buf, size_t len)
 {
-	if (has_pipe && (dup2(pipe_fds[end], end) == -1 || \
-		close(pipe_fds[0]) == -1 || close(pipe_fds[1]) == -1))
-		ft_print_error("error: fatal\n"), exit(EXIT_FAILURE);
+	ssize_t done;
+
+	while (len)
+	{
+		done = write(fd, buf, len);
+		if (done == -1 && errno == EINTR)
+			continue ;
+		if (done == -1)
+			ft_exit_fatal();
+		buf += done;
+		len -= done;
+	}
 }
 
-// Function to execute commands and handle pipes
-int ft_execute_command(char **arg, int arg_count, char **env)
+// Function to make a here-string (plus a newline) the fd to read: a pipe
+// filled up front when it fits, else a sealed memfd, so nothing blocks
+int ft_here_string(char *data)
 {
-	int has_pipe, pipe_fds[2], pid, code;
+	size_t len = strlen(data);
+	int fds[2];
 
-	has_pipe = arg[arg_count] && !strcmp(arg[arg_count], "|");
-	if (!has_pipe && !strcmp(*arg, "cd"))
-		return (ft_execute_cd(arg, arg_count));
-	if (has_pipe && pipe(pipe_fds) == -1)
-		ft_print_error("error: fatal\n"), exit(EXIT_FAILURE);
-	if ((pid = fork()) == -1)
-		ft_print_error("error: fatal\n"), exit(EXIT_FAILURE);
-	if (pid == 0)
+	if (pipe(fds) == -1)
+		ft_exit_fatal();
+	if (len < (size_t)fcntl(fds[1], F_GETPIPE_SZ))
 	{
-		arg[arg_count] = NULL;
-		ft_configure_pipe(has_pipe, pipe_fds, STDOUT_FILENO);
-		if (!strcmp(*arg, "cd"))
-			exit(ft_execute_cd(arg, arg_count));
-		execve(arg[0], arg, env);
-		ft_print_error("error: cannot execute "), ft_print_error(arg[0]), \
-		ft_print_error("\n"), exit(EXIT_FAILURE);
+		ft_write_all(fds[1], data, len);
+		ft_write_all(fds[1], "\n", 1);
+		return (close(fds[1]), fds[0]);
 	}
-	waitpid(pid, &code, 0);
-	ft_configure_pipe(has_pipe, pipe_fds, STDIN_FILENO);
-	return (WIFEXITED(code) && WEXITcode(code));
+	close(fds[0]);
+	close(fds[1]);
+	if ((fds[0] = memfd_create("here-string", MFD_ALLOW_SEALING)) == -1)
+		ft_exit_fatal();
+	ft_write_all(fds[0], data, len);
+	ft_write_all(fds[0], "\n", 1);
+	if (fcntl(fds[0], F_ADD_SEALS, F_SEAL_WRITE | F_SEAL_GROW | \
+		F_SEAL_SHRINK | F_SEAL_SEAL) == -1 || lseek(fds[0], 0, SEEK_SET) == -1)
+		ft_exit_fatal();
+	return (fds[0]);
 }
 
-// Main function to parse and execute commands
-int main(int argc, char **argv, char **env)
+// Function to apply a stage's redirections in the child, after its pipes
+// so they win, and drop them from argv; returns how many arguments remain
+int ft_configure_redirects(char **arg, int arg_count)
 {
-	(void)argc;
-	int index = 0, code = 0;
+	static const int flags[] = {0, O_RDONLY, O_WRONLY | O_CREAT | O_TRUNC, \
+		O_WRONLY | O_CREAT | O_APPEND, 0};
+	int index, kept = 0, kind, fd;
 
-	while (argv[index])
+	for (index = 0; index < arg_count; index++)
 	{
-		argv += index + 1;
-		index = 0;
-		while (argv[index] && strcmp(argv[index], "|") && \
-		strcmp(argv[index], ";"))
-			index++;
-		if (index)
-			code = ft_execute_command(argv, index, env);
+		if (!(kind = ft_redirection(arg[index])))
+		{
+			arg[kept++] = arg[index];
+			continue ;
+		}
+		if (++index == arg_count)
+			ft_print_error("error: missing file after "), \
+			ft_print_error(arg[index - 1]), ft_print_error("\n"), \
+			exit(EXIT_FAILURE);
+		if (kind == REDIR_HERE)
+			fd = ft_here_string(arg[index]);
+		else if ((fd = open(arg[index], flags[kind], 0666)) == -1)
+			ft_print_error("error: cannot open "), ft_print_error(arg[index]), \
+			ft_print_error("\n"), exit(EXIT_FAILURE);
+		if (dup2(fd, kind == REDIR_IN || kind == REDIR_HERE ? STDIN_FILENO \
+			: STDOUT_FILENO) == -1 \
+			|| close(fd) == -1)
+			ft_exit_fatal();
 	}
+	arg[kept] = NULL;
+	return (kept);
+}
+
+// Function to set up a pipe if needed
+void ft_configure_pipe(int has_pipe, int *pipe_fds, int end)
+{
+	if (has_pipe && (dup2(pipe_fds[end], end) == -1 || \
+		close(pipe_fds[0]) == -1 || close(pipe_fds[1]) == -1))
+		ft_exit_fatal();
+	if (has_pipe && g_trace && end == STDIN_FILENO)
+		ft_trace('i', "pipe close", g_trace->pid, ft_clock_ns(), \
+			pipe_fds[1], NULL), ft_trace_count(&g_trace->fds, -2, "fds");
+	else if (has_pipe && g_trace)
+		ft_trace('i', "pipe dup", getpid(), ft_clock_ns(), pipe_fds[1], NULL);
+}
+
+// Function to turn a wait status into an exit code
+int ft_exit_code(int status)
+{
+	if (WIFSIGNALED(status))
+		return (128 + WTERMSIG(status));
+	return (WEXITSTATUS(status));
+}
+
+// Function to read the first CPU of a sysfs list ("8-11,40-43" -> 8)
+int ft_sysfs_first(int cpu, int cache_index, char *file)
+{
+	char path[128], buf[32];
+	int fd, len, index = 0, value = 0;
+
+	if (cache_index < 0)
+		snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/%s", \
+			cpu, file);
+	else
+		snprintf(path, sizeof(path), \
+			"/sys/devices/system/cpu/cpu%d/cache/index%d/%s", \
+			cpu, cache_index, file);
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) == -1)
+		return (-1);
+	len = read(fd, buf, sizeof(buf));
+	close(fd);
+	if (len <= 0 || buf[0] < '0' || buf[0] > '9')
+		return (-1);
+	while (index < len && buf[index] >= '0' && buf[index] <= '9')
+		value = value * 10 + buf[index++] - '0';
+	return (value);
+}
+
+// Function to fill the sort keys of one CPU (missing levels fall back to it)
+void ft_topology_keys(int cpu, int *key)
+{
+	int index, level;
+
+	key[KEY_CORE] = ft_sysfs_first(cpu, -1, "topology/thread_siblings_list");
+	key[KEY_L2] = -1;
+	key[KEY_L3] = -1;
+	for (index = 0; index < 8; index++)
+	{
+		if ((level = ft_sysfs_first(cpu, index, "level")) == 2)
+			key[KEY_L2] = ft_sysfs_first(cpu, index, "shared_cpu_list");
+		else if (level == 3)
+			key[KEY_L3] = ft_sysfs_first(cpu, index, "shared_cpu_list");
+	}
+	if (key[KEY_CORE] == -1)
+		key[KEY_CORE] = cpu;
+	if (key[KEY_L2] == -1)
+		key[KEY_L2] = key[KEY_CORE];
+	if (key[KEY_L3] == -1)
+		key[KEY_L3] = key[KEY_L2];
+}
+
+// Function to compare two CPUs in topology order (for qsort)
+int ft_topology_cmp(const void *a, const void *b)
+{
+	const t_cpu *left = a, *right = b;
+	int level;
+
+	for (level = KEY_L3; level <= KEY_CORE; level++)
+		if (left->key[level] != right->key[level])
+			return (left->key[level] - right->key[level]);
+	return (left->id - right->id);
+}
+
+// Function to read the topology of the CPUs we may run on, once
+void ft_load_topology(t_topology *topo)
+{
+	cpu_set_t allowed;
+	int cpu, index, level;
+
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) == -1)
+		return ;
+	for (cpu = 0; cpu < CPU_SETSIZE; cpu++)
+	{
+		if (!CPU_ISSET(cpu, &allowed))
+			continue ;
+		topo->cpu[topo->count].id = cpu;
+		ft_topology_keys(cpu, topo->cpu[topo->count++].key);
+	}
+	qsort(topo->cpu, topo->count, sizeof(t_cpu), ft_topology_cmp);
+	for (level = KEY_L3; level <= KEY_CORE; level++)
+		for (index = 0; index < topo->count; index++)
+			topo->domains[level] += !index || topo->cpu[index].key[level] \
+				!= topo->cpu[index - 1].key[level];
+}
+
+// Function to place the calling stage before it runs (best effort)
+void ft_apply_placement(void)
+{
+	cpu_set_t set;
+	int index, level, domain, seen = -1, nice;
+
+	if (g_shell.boost && g_shell.depth > g_shell.slot)
+	{
+		nice = getpriority(PRIO_PROCESS, 0);
+		setpriority(PRIO_PROCESS, 0, nice + g_shell.boost * \
+			(g_shell.depth - 1 - g_shell.slot));
+	}
+	if (g_shell.placement == PLACE_NONE || !g_topology.count)
+		return ;
+	CPU_ZERO(&set);
+	if (g_shell.placement == PLACE_COMPACT)
+		CPU_SET(g_topology.cpu[g_shell.slot % g_topology.count].id, &set);
+	else
+	{
+		level = g_shell.placement == PLACE_CACHE ? KEY_L2 : KEY_L3;
+		domain = g_shell.job % g_topology.domains[level];
+		for (index = 0; index < g_topology.count; index++)
+		{
+			seen += !index || g_topology.cpu[index].key[level] != \
+				g_topology.cpu[index - 1].key[level];
+			if (seen == domain)
+				CPU_SET(g_topology.cpu[index].id, &set);
+		}
+	}
+	sched_setaffinity(0, sizeof(set), &set);
+}
+
+// Function to map a latency in ns to its bucket, in constant time
+int ft_hist_bucket(uint64_t ns)
+{
+	int magnitude;
+
+	if (ns < (1u << HIST_SUB_BITS))
+		return (ns);
+	magnitude = 63 - __builtin_clzll(ns);
+	if (magnitude >= HIST_TOP)
+		return (HIST_BUCKETS - 1);
+	return ((magnitude - HIST_SUB_BITS + 1) << HIST_SUB_BITS | \
+		(ns >> (magnitude - HIST_SUB_BITS) & ((1 << HIST_SUB_BITS) - 1)));
+}
+
+// Function to give the highest latency a bucket stands for
+uint64_t ft_hist_value(int bucket)
+{
+	int shift = (bucket >> HIST_SUB_BITS) - 1;
+
+	if (shift < 0)
+		return (bucket);
+	return (((uint64_t)(bucket & ((1 << HIST_SUB_BITS) - 1)) | \
+		1 << HIST_SUB_BITS) << shift | ((1ULL << shift) - 1));
+}
+
+// Function to record one latency: no lock, no allocation
+void ft_hist_add(int key, int metric, int64_t ns)
+{
+	t_hist *hist;
+	uint64_t max;
+
+	if (!g_hists || key < 0 || ns < 0)
+		return ;
+	hist = &g_hists->key[key].metric[metric];
+	__atomic_fetch_add(&hist->bucket[ft_hist_bucket(ns)], 1, \
+		__ATOMIC_RELAXED);
+	__atomic_fetch_add(&hist->count, 1, __ATOMIC_RELAXED);
+	max = __atomic_load_n(&hist->max, __ATOMIC_RELAXED);
+	while ((uint64_t)ns > max && !__atomic_compare_exchange_n(&hist->max, \
+		&max, ns, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+		;
+}
+
+// Function to find the histograms of argv[0], adding them on first sight;
+// past HIST_KEYS names, the last key takes the rest
+int ft_hist_key(char *name)
+{
+	int index, keys;
+
+	keys = __atomic_load_n(&g_hists->keys, __ATOMIC_ACQUIRE);
+	for (index = 0; index < keys; index++)
+		if (!strncmp(g_hists->key[index].name, name, 63))
+			return (index);
+	while (__atomic_test_and_set(&g_hists->lock, __ATOMIC_ACQUIRE))
+		;
+	for (; index < g_hists->keys; index++)
+		if (!strncmp(g_hists->key[index].name, name, 63))
+			break ;
+	if (index == g_hists->keys && index < HIST_KEYS)
+	{
+		strncpy(g_hists->key[index].name, index + 1 < HIST_KEYS ? name \
+			: "(other)", 63);
+		__atomic_store_n(&g_hists->keys, index + 1, __ATOMIC_RELEASE);
+	}
+	__atomic_clear(&g_hists->lock, __ATOMIC_RELEASE);
+	return (index < HIST_KEYS ? index : HIST_KEYS - 1);
+}
+
+// Function to take a free live slot for a stage about to be forked
+int ft_hist_claim(int key)
+{
+	pid_t free_pid;
+	int index;
+
+	for (index = 0; index < HIST_LIVE; index++)
+	{
+		free_pid = 0;
+		if (__atomic_compare_exchange_n(&g_hists->live[index].pid, \
+			&free_pid, -1, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+		{
+			g_hists->live[index].key = key;
+			g_hists->live[index].exec_ns = 0;
+			g_hists->live[index].exit_ns = 0;
+			return (index);
+		}
+	}
+	return (-1);
+}
+
+// Function to stamp the exit of every timed child that is now a zombie
+// (SIGCHLD handler: signals coalesce, so one may stand for several)
+void ft_hist_sigchld(int sig, siginfo_t *info, void *context)
+{
+	t_hist_live *live;
+	siginfo_t child;
+	int index, saved = errno;
+
+	(void)sig, (void)info, (void)context;
+	for (index = 0; index < HIST_LIVE; index++)
+	{
+		live = &g_hists->live[index];
+		child.si_pid = 0;
+		if (live->pid > 0 && !live->exit_ns && waitid(P_PID, live->pid, \
+			&child, WEXITED | WNOHANG | WNOWAIT) == 0 && \
+			child.si_pid == live->pid)
+			live->exit_ns = ft_clock_ns();
+	}
+	errno = saved;
+}
+
+// Function to account a reaped stage: exec to exit, and exit to reap; a
+// stage with no exit stamp was reaped by the wait its exit woke (SIGCHLD
+// comes after that reap), so the reap itself is its exit
+void ft_hist_reap(pid_t pid)
+{
+	t_hist_live *live;
+	int64_t now;
+	int index;
+
+	if (!g_hists)
+		return ;
+	for (index = 0; index < HIST_LIVE; index++)
+	{
+		live = &g_hists->live[index];
+		if (live->pid != pid)
+			continue ;
+		now = ft_clock_ns();
+		if (!live->exit_ns)
+			live->exit_ns = now;
+		if (live->exec_ns)
+			ft_hist_add(live->key, HIST_RUN, live->exit_ns - live->exec_ns);
+		ft_hist_add(live->key, HIST_REAP, now - live->exit_ns);
+		__atomic_store_n(&live->pid, 0, __ATOMIC_RELEASE);
+		return ;
+	}
+}
+
+// Function to start timing a stage this process just forked
+void ft_metrics_fork(pid_t pid)
+{
+	int index;
+
+	for (index = 0; g_metrics && index < METRIC_LIVE; index++)
+		if (!g_metric_live[index].pid)
+		{
+			g_metric_live[index] = (t_metric_live){pid, ft_clock_ns()};
+			return ;
+		}
+}
+
+// Function to put a reaped stage's fork-to-reap time in its bucket
+void ft_metrics_reap(pid_t pid)
+{
+	int64_t ns;
+	int index, bucket;
+
+	for (index = 0; g_metrics && index < METRIC_LIVE; index++)
+	{
+		if (g_metric_live[index].pid != pid)
+			continue ;
+		ns = ft_clock_ns() - g_metric_live[index].start;
+		g_metric_live[index].pid = 0;
+		for (bucket = 0; bucket < METRIC_BUCKETS && \
+			ns > g_metric_bounds[bucket]; bucket++)
+			;
+		__atomic_fetch_add(&g_metrics->bucket[bucket], 1, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&g_metrics->run_ns, ns, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&g_metrics->runs, 1, __ATOMIC_RELAXED);
+		return ;
+	}
+}
+
+// Function to get the histograms of a stage about to be forked ready: a
+// live slot, and SIGCHLD held until that slot knows the pid
+void ft_hist_fork(char *name, sigset_t *saved)
+{
+	sigset_t mask;
+
+	g_shell.hist_slot = ft_hist_claim(ft_hist_key(name));
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGCHLD);
+	sigprocmask(SIG_BLOCK, &mask, saved);
+	g_shell.spawn_start = ft_clock_ns();
+}
+
+// Function to note, in the child, that the stage is about to exec
+void ft_hist_exec(void)
+{
+	int64_t now;
+
+	if (!g_hists || g_shell.hist_slot < 0)
+		return ;
+	now = ft_clock_ns();
+	g_hists->live[g_shell.hist_slot].exec_ns = now;
+	ft_hist_add(g_hists->live[g_shell.hist_slot].key, HIST_SPAWN, \
+		now - g_shell.spawn_start);
+}
+
+// Function to append a string to a line being built without stdio
+int ft_hist_put(char *line, int pos, const char *str)
+{
+	while (*str && pos < 255)
+		line[pos++] = *str++;
+	return (pos);
+}
+
+// Function to append a number in decimal
+int ft_hist_put_num(char *line, int pos, uint64_t value)
+{
+	char digits[24];
+	int len = 0;
+
+	do
+		digits[len++] = '0' + value % 10;
+	while ((value /= 10));
+	while (len && pos < 255)
+		line[pos++] = digits[--len];
+	return (pos);
+}
+
+// Function to append a latency as microseconds with one decimal
+int ft_hist_put_us(char *line, int pos, uint64_t ns)
+{
+	pos = ft_hist_put_num(line, pos, ns / 1000);
+	pos = ft_hist_put(line, pos, ".");
+	pos = ft_hist_put_num(line, pos, ns / 100 % 10);
+	return (ft_hist_put(line, pos, "us"));
+}
+
+// Function to write a dump line to stderr, retrying short writes; errors
+// are dropped (no ft_write_all: exit() is no place for a signal handler)
+void ft_hist_write(char *line, int len)
+{
+	ssize_t done;
+
+	while (len > 0)
+	{
+		if ((done = write(STDERR_FILENO, line, len)) == -1 && errno == EINTR)
+			continue ;
+		if (done <= 0)
+			return ;
+		line += done;
+		len -= done;
+	}
+}
+
+// Function to print every histogram to stderr, one line per argv[0] and
+// metric; write(2) and arithmetic only, so SIGUSR1 can run it any time
+void ft_hist_dump(void)
+{
+	static const char *metrics[] = {"spawn", "run", "reap"};
+	static const int permille[] = {500, 900, 990, 999};
+	static const char *labels[] = {" p50=", " p90=", " p99=", " p99.9="};
+	t_hist *hist;
+	uint64_t seen, rank;
+	char line[256];
+	int key, metric, pos, bucket, index;
+
+	for (key = 0; g_hists && key < g_hists->keys; key++)
+	{
+		for (metric = 0; metric < 3; metric++)
+		{
+			hist = &g_hists->key[key].metric[metric];
+			if (!hist->count)
+				continue ;
+			pos = ft_hist_put(line, 0, "hist: ");
+			pos = ft_hist_put(line, pos, g_hists->key[key].name);
+			pos = ft_hist_put(line, pos, " ");
+			pos = ft_hist_put(line, pos, metrics[metric]);
+			pos = ft_hist_put(line, pos, " n=");
+			pos = ft_hist_put_num(line, pos, hist->count);
+			for (index = 0, seen = 0, bucket = 0; index < 4; index++)
+			{
+				rank = (hist->count * permille[index] + 999) / 1000;
+				while (bucket < HIST_BUCKETS && \
+					seen + hist->bucket[bucket] < rank)
+					seen += hist->bucket[bucket++];
+				pos = ft_hist_put(line, pos, labels[index]);
+				pos = ft_hist_put_us(line, pos, ft_hist_value(bucket) \
+					< hist->max ? ft_hist_value(bucket) : hist->max);
+			}
+			pos = ft_hist_put(line, pos, " max=");
+			pos = ft_hist_put_us(line, pos, hist->max);
+			line[pos++] = '\n';
+			ft_hist_write(line, pos);
+		}
+	}
+}
+
+// Function to answer SIGUSR1 with a dump
+void ft_hist_sigusr1(int sig)
+{
+	int saved = errno;
+
+	(void)sig;
+	ft_hist_dump();
+	errno = saved;
+}
+
+// Function to map the histograms and install their signal handlers
+void ft_hist_open(void)
+{
+	struct sigaction act = {0};
+
+	if ((g_hists = mmap(NULL, sizeof(t_hists), PROT_READ | PROT_WRITE, \
+		MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0)) == MAP_FAILED)
+	{
+		g_hists = NULL;
+		return ;
+	}
+	act.sa_sigaction = ft_hist_sigchld;
+	act.sa_flags = SA_SIGINFO | SA_RESTART | SA_NOCLDSTOP;
+	sigaction(SIGCHLD, &act, NULL);
+	act.sa_handler = ft_hist_sigusr1;
+	act.sa_flags = SA_RESTART;
+	sigaction(SIGUSR1, &act, NULL);
+}
+
+// Function to count the stages of the pipeline starting at cmd
+int ft_pipeline_depth(t_command *cmd, int left)
+{
+	int depth = 1;
+
+	while (depth < left && cmd[depth - 1].sep == SEP_PIPE)
+		depth++;
+	return (depth);
+}
+
+// Function to add a reaped stage's usage to the timed group's totals
+void ft_time_account(struct rusage *usage)
+{
+	struct rusage *total = &g_shell.time_usage;
+
+	timeradd(&total->ru_utime, &usage->ru_utime, &total->ru_utime);
+	timeradd(&total->ru_stime, &usage->ru_stime, &total->ru_stime);
+	if (usage->ru_maxrss > total->ru_maxrss)
+		total->ru_maxrss = usage->ru_maxrss;
+}
+
+// Function to handle a "time [-j] pipeline" prefix: strip it, count the
+// stages and start the clock; returns 0 when no command follows it
+int ft_time_start(t_command *cmd)
+{
+	int skip = 1;
+
+	if (cmd->count > 1 && !strcmp(cmd->arg[1], "-j"))
+		skip = 2;
+	g_shell.timing = skip == 2 ? TIME_JSON : TIME_HUMAN;
+	g_shell.time_usage = (struct rusage){0};
+	g_shell.time_start = ft_clock_ns();
+	cmd->arg += skip;
+	cmd->count -= skip;
+	g_shell.time_stages = cmd->count ? \
+		ft_pipeline_depth(cmd, g_shell.left + 1) : 0;
+	return (cmd->count);
+}
+
+// Function to print what the timed group cost (wall, summed CPU, peak RSS
+// of any one stage, stage count) to stderr; passes the group's code along
+int ft_time_report(int code)
+{
+	struct rusage *total = &g_shell.time_usage;
+	double real, user, sys;
+	char line[256];
+
+	if (!g_shell.timing)
+		return (code);
+	real = (ft_clock_ns() - g_shell.time_start) / 1e9;
+	user = total->ru_utime.tv_sec + total->ru_utime.tv_usec / 1e6;
+	sys = total->ru_stime.tv_sec + total->ru_stime.tv_usec / 1e6;
+	if (g_shell.timing == TIME_JSON)
+		snprintf(line, sizeof(line), "{\"real\":%.6f,\"user\":%.6f,"
+			"\"sys\":%.6f,\"maxrss_kb\":%ld,\"stages\":%d,\"code\":%d}\n", \
+			real, user, sys, total->ru_maxrss, g_shell.time_stages, code);
+	else
+		snprintf(line, sizeof(line), "time: real %.3fs user %.3fs sys %.3fs "
+			"maxrss %ld KiB, %d stage%s\n", real, user, sys, \
+			total->ru_maxrss, g_shell.time_stages, \
+			g_shell.time_stages == 1 ? "" : "s");
+	ft_print_error(line);
+	g_shell.timing = 0;
+	return (code);
+}
+
+// Function to parse "kind=value[,kind=value]..." into lim; sizes (as, core)
+// take K/M/G/T suffixes, cpu is in seconds; returns 0 on a bad spec
+int ft_limit_parse(char *spec, t_limits *lim)
+{
+	static const char *kinds[] = {"as=", "cpu=", "nofile=", "nproc=", \
+		"core="};
+	char *end;
+	int kind;
+	rlim_t value;
+
+	while (*spec)
+	{
+		for (kind = 0; kind < LIMIT_KINDS && strncmp(spec, kinds[kind], \
+			strlen(kinds[kind])); kind++)
+			;
+		if (kind == LIMIT_KINDS)
+			return (0);
+		spec += strlen(kinds[kind]);
+		if (!strncmp(spec, "unlimited", 9))
+			value = RLIM_INFINITY, end = spec + 9;
+		else if ((value = strtoull(spec, &end, 10)), end == spec)
+			return (0);
+		if ((kind == LIMIT_AS || kind == LIMIT_CORE) && *end && \
+			strchr("KMGT", *end) && value != RLIM_INFINITY)
+			value <<= 10 * (strchr("KMGT", *end++) - "KMGT" + 1);
+		if (*end && *end != ',')
+			return (0);
+		lim->value[kind] = value;
+		lim->set |= 1 << kind;
+		spec = *end ? end + 1 : end;
+	}
+	return (1);
+}
+
+// Function to strip a "limit kind=value... cmd" prefix into the limits of
+// the stage about to fork (the --limit= defaults, overridden per kind); in
+// front of a fan-in group it covers each producer. A separator or a last
+// word that parses as a spec means there is no command: a bad arg too
+void ft_limit_stage(t_command *cmd)
+{
+	t_limits probe = {0};
+
+	g_shell.stage_limits = g_shell.limits;
+	g_shell.limit_error = NULL;
+	if (cmd->count < 2 || strcmp(*cmd->arg, "limit"))
+		return ;
+	cmd->arg++;
+	cmd->count--;
+	while (cmd->count > 1 && strchr(*cmd->arg, '='))
+	{
+		if (!ft_limit_parse(*cmd->arg, &g_shell.stage_limits))
+			g_shell.limit_error = *cmd->arg;
+		cmd->arg++;
+		cmd->count--;
+	}
+	if (ft_separator(*cmd->arg) != SEP_NONE)
+		g_shell.limit_error = cmd->arg[-1];
+	else if (strchr(*cmd->arg, '=') && ft_limit_parse(*cmd->arg, &probe))
+		g_shell.limit_error = *cmd->arg;
+}
+
+// Function to apply the stage's limits in the child, right before it
+// becomes the command; cpu gets one second of hard limit past the soft
+// one, so SIGXCPU comes first and SIGKILL only if it was caught
+void ft_limit_apply(void)
+{
+	static const int resources[] = {RLIMIT_AS, RLIMIT_CPU, RLIMIT_NOFILE, \
+		RLIMIT_NPROC, RLIMIT_CORE};
+	struct rlimit rl;
+	int kind;
+
+	if (g_shell.limit_error)
+		ft_print_error("error: limit: bad arg "), \
+		ft_print_error(g_shell.limit_error), ft_print_error("\n"), \
+		exit(EXIT_FAILURE);
+	for (kind = 0; kind < LIMIT_KINDS; kind++)
+	{
+		if (!(g_shell.stage_limits.set & 1 << kind))
+			continue ;
+		rl.rlim_cur = g_shell.stage_limits.value[kind];
+		rl.rlim_max = rl.rlim_cur;
+		if (kind == LIMIT_CPU && rl.rlim_max != RLIM_INFINITY)
+			rl.rlim_max++;
+		if (setrlimit(resources[kind], &rl) == -1)
+			ft_print_error("error: limit: cannot set limit\n"), \
+			exit(EXIT_FAILURE);
+	}
+}
+
+// Function to remember a limited stage the shell just forked (not one that
+// only reports a bad arg)
+void ft_limit_track(pid_t pid, const char *arg)
+{
+	int index;
+
+	if (!g_shell.stage_limits.set || g_shell.limit_error)
+		return ;
+	for (index = 0; index < LIMIT_LIVE && g_limited[index].pid; index++)
+		;
+	if (index < LIMIT_LIVE)
+		g_limited[index] = (t_limited){pid, arg, g_shell.stage_limits};
+}
+
+// Function to append the limits in force to a report line
+void ft_limit_describe(char *line, size_t size, t_limits *lim)
+{
+	static const char *names[] = {"as", "cpu", "nofile", "nproc", "core"};
+	size_t len;
+	int kind;
+
+	for (kind = 0; kind < LIMIT_KINDS; kind++)
+	{
+		len = strlen(line);
+		if (!(lim->set & 1 << kind) || len + 1 >= size)
+			continue ;
+		if (lim->value[kind] == RLIM_INFINITY)
+			snprintf(line + len, size - len, " %s=unlimited", names[kind]);
+		else
+			snprintf(line + len, size - len, " %s=%llu", names[kind], \
+				(unsigned long long)lim->value[kind]);
+	}
+}
+
+// Function to tell how a reaped stage ended, blaming its limits when it
+// failed: SIGXCPU, or SIGKILL with the CPU time past the cpu limit, is a
+// certain hit, reported as SIGXCPU (128 + 24) either way; a peak
+// RSS past half the as limit is a likely one; any other failure lists
+// the limits in force. Returns the stage's exit code
+int ft_limit_check(pid_t pid, int status, struct rusage *usage)
+{
+	t_limited *stage;
+	char line[512];
+	double cpu;
+	int index, code = ft_exit_code(status);
+
+	for (index = 0; index < LIMIT_LIVE && g_limited[index].pid != pid; \
+		index++)
+		;
+	if (pid <= 0 || index == LIMIT_LIVE)
+		return (code);
+	stage = &g_limited[index];
+	stage->pid = 0;
+	cpu = usage->ru_utime.tv_sec + usage->ru_stime.tv_sec + \
+		(usage->ru_utime.tv_usec + usage->ru_stime.tv_usec) / 1e6;
+	if (!code)
+		return (code);
+	if ((stage->limits.set & 1 << LIMIT_CPU) && WIFSIGNALED(status) && \
+		(WTERMSIG(status) == SIGXCPU || (WTERMSIG(status) == SIGKILL && \
+		cpu >= stage->limits.value[LIMIT_CPU])))
+	{
+		code = 128 + SIGXCPU;
+		snprintf(line, sizeof(line), "limit: %s killed by SIGXCPU: cpu=%llus "
+			"hit (%.2fs used)\n", stage->arg, \
+			(unsigned long long)stage->limits.value[LIMIT_CPU], cpu);
+	}
+	else if ((stage->limits.set & 1 << LIMIT_AS) && \
+		(rlim_t)usage->ru_maxrss * 1024 * 2 >= stage->limits.value[LIMIT_AS])
+		snprintf(line, sizeof(line), "limit: %s failed (status %d), likely "
+			"as=%llu hit (peak RSS %ld KiB)\n", stage->arg, code, \
+			(unsigned long long)stage->limits.value[LIMIT_AS], \
+			usage->ru_maxrss);
+	else
+	{
+		snprintf(line, sizeof(line), "limit: %s failed (status %d) under", \
+			stage->arg, code);
+		ft_limit_describe(line, sizeof(line) - 1, &stage->limits);
+		strcat(line, "\n");
+	}
+	ft_print_error(line);
+	ft_trace('i', "limit", pid, ft_clock_ns(), code, stage->arg);
+	return (code);
+}
+
+// Function to hand the terminal to a process group (back to ours as well,
+// which by then is in the background, hence SIGTTOU ignored meanwhile)
+void ft_foreground(pid_t pgid)
+{
+	void (*old)(int);
+
+	if (g_shell.tty < 0)
+		return ;
+	old = signal(SIGTTOU, SIG_IGN);
+	tcsetpgrp(g_shell.tty, pgid);
+	signal(SIGTTOU, old);
+}
+
+// Function to stop what is left of a pipeline whose last stage is gone:
+// upstream stages get --teardown ms to exit on their own (their next write
+// to the dead pipe kills them), then SIGTERM, then SIGKILL for the ones
+// that ignore both; returns 0 once there is nothing left to poll for
+int ft_teardown(int64_t gone, int *termed)
+{
+	int64_t waited = (ft_clock_ns() - gone) / 1000000;
+
+	if (g_shell.pgid <= 0 || kill(-g_shell.pgid, 0) == -1)
+		return (0);
+	if (waited >= 2 * g_shell.teardown + TEARDOWN_KILL)
+		return (killpg(g_shell.pgid, SIGKILL), 0);
+	if (waited >= g_shell.teardown && !*termed)
+		*termed = killpg(g_shell.pgid, SIGTERM) == 0;
+	nanosleep(&(struct timespec){0, 1000000}, NULL);
+	return (1);
+}
+
+// Function to reap every stage still running and keep the last one's code;
+// once the last stage is reaped, the rest is polled for and torn down
+int ft_wait_pipeline(pid_t last)
+{
+	int status, code = 0, flags = 0, termed = 0, stage_code;
+	int64_t wait_start = g_trace ? ft_clock_ns() : 0, gone = 0;
+	struct rusage usage;
+	pid_t pid;
+
+	while ((pid = wait4(-1, &status, flags, &usage)) != -1 || errno == EINTR)
+	{
+		if (pid == 0)
+		{
+			flags = ft_teardown(gone, &termed) ? WNOHANG : 0;
+			continue ;
+		}
+		ft_trace_reap(pid, wait_start);
+		ft_hist_reap(pid);
+		ft_metrics_reap(pid);
+		MSH_PROBE2(reap, pid, status);
+		stage_code = ft_limit_check(pid, status, &usage);
+		if (g_shell.timing && pid > 0)
+			ft_time_account(&usage);
+		wait_start = g_trace ? ft_clock_ns() : 0;
+		if (pid == last)
+			code = stage_code, gone = ft_clock_ns(), \
+			flags = g_shell.teardown >= 0 ? WNOHANG : 0;
+		if (pid == g_shell.tee_pid)
+			g_shell.tee_status = status;
+	}
+	ft_foreground(getpgrp());
+	return (code);
+}
+
+// Function to tell whether a stage runs the shell's own code instead of a
+// binary (0): made only of redirections, it is a copy stage (ft_exec_copy);
+// a builtin grep or sort works on the bytes in its own memory
+int ft_stage_internal(t_command *cmd)
+{
+	int index;
+
+	if (cmd->fan_in || !cmd->count)
+		return (0);
+	if (ft_builtin_stage(cmd->arg, cmd->count))
+		return (STAGE_MEMORY);
+	if (cmd->count & 1)
+		return (0);
+	for (index = 0; index < cmd->count; index += 2)
+		if (!ft_redirection(cmd->arg[index]))
+			return (0);
+	return (STAGE_COPY);
+}
+
+// Function to get a ring for the link after cmd when both of its ends are
+// internal; NULL means a pipe: an external binary needs an fd, so do the
+// --pipe-stats relays, and two copy stages splice through a pipe without
+// copying at all, which beats any ring (kept for --ring=always)
+t_ring *ft_ring_open(t_command *cmd)
+{
+	t_ring *ring;
+	int fd, from, to;
+
+	if (g_shell.ring == RING_OFF || g_shell.pipe_stats || \
+		!(from = ft_stage_internal(cmd)) || !(to = ft_stage_internal(cmd + 1)) \
+		|| (g_shell.ring == RING_AUTO && from == STAGE_COPY && \
+		to == STAGE_COPY) || (fd = memfd_create("msh-ring", MFD_CLOEXEC)) == -1)
+		return (NULL);
+	if (ftruncate(fd, sizeof(t_ring)) == -1 || (ring = mmap(NULL, \
+		sizeof(t_ring), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) \
+		== MAP_FAILED)
+		ring = NULL;
+	close(fd);
+	if (ring && g_trace)
+		ft_trace('i', "ring", g_trace->pid, ft_clock_ns(), g_shell.slot, NULL);
+	return (ring);
+}
+
+// Function to hand the rings to the stage just forked, in the shell: the
+// stage reading the input ring now has it, so the shell's mapping goes;
+// the output ring is the next stage's input, and with no pipe read end to
+// give it, the next stage starts from the shell's own stdin
+void ft_ring_forked(pid_t pid)
+{
+	if (g_shell.ring_in)
+		__atomic_store_n(&g_shell.ring_in->consumer, pid, __ATOMIC_RELAXED), \
+		munmap(g_shell.ring_in, sizeof(t_ring));
+	if ((g_shell.ring_in = g_shell.ring_out))
+		__atomic_store_n(&g_shell.ring_in->producer, pid, __ATOMIC_RELAXED);
+	if ((g_shell.ring_out = NULL, g_shell.ring_in) && \
+		dup2(g_shell.stdin_copy, STDIN_FILENO) == -1)
+		ft_exit_fatal();
+}
+
+// Function to bump a futex word after a step, waking its sleeper if any
+void ft_ring_wake(uint32_t *word, uint32_t *waiting)
+{
+	__atomic_add_fetch(word, 1, __ATOMIC_SEQ_CST);
+	if (__atomic_load_n(waiting, __ATOMIC_SEQ_CST))
+		syscall(SYS_futex, word, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+// Function to sleep until a futex word moves off seen; returns 0 when a
+// timed-out sleep finds the other side dead (it never said done or gone)
+int ft_ring_sleep(uint32_t *word, uint32_t seen, uint32_t *waiting, \
+	pid_t *peer)
+{
+	struct timespec limit = {0, RING_POLL_MS * 1000000L};
+	long slept;
+	pid_t pid;
+
+	__atomic_store_n(waiting, 1, __ATOMIC_SEQ_CST);
+	slept = syscall(SYS_futex, word, FUTEX_WAIT, seen, &limit, NULL, 0);
+	__atomic_store_n(waiting, 0, __ATOMIC_SEQ_CST);
+	if (slept == 0 || errno != ETIMEDOUT)
+		return (1);
+	return (!(pid = __atomic_load_n(peer, __ATOMIC_RELAXED)) || \
+		kill(pid, 0) == 0 || errno == EPERM);
+}
+
+// Function to wait for bytes in the ring: returns how many sit in a row at
+// *data, 0 once the producer is done (or dead) and everything was read
+size_t ft_ring_peek(t_ring *ring, char **data)
+{
+	uint32_t tail = ring->tail, head, seq, done;
+
+	while (1)
+	{
+		seq = __atomic_load_n(&ring->data_seq, __ATOMIC_SEQ_CST);
+		done = __atomic_load_n(&ring->done, __ATOMIC_ACQUIRE);
+		if ((head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE)) != tail)
+			break ;
+		if (done || !ft_ring_sleep(&ring->data_seq, seq, &ring->data_wait, \
+			&ring->producer))
+			return (0);
+	}
+	*data = ring->data + (tail & (RING_SIZE - 1));
+	head -= tail;
+	tail = RING_SIZE - (tail & (RING_SIZE - 1));
+	return (head < tail ? head : tail);
+}
+
+// Function to wait for room in the ring: returns how many bytes can be
+// written in a row at *data, 0 once the consumer is gone (or dead)
+size_t ft_ring_reserve(t_ring *ring, char **data)
+{
+	uint32_t head = ring->head, room, seq;
+
+	while (1)
+	{
+		seq = __atomic_load_n(&ring->space_seq, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&ring->gone, __ATOMIC_ACQUIRE))
+			return (0);
+		if ((room = RING_SIZE - (head - __atomic_load_n(&ring->tail, \
+			__ATOMIC_ACQUIRE))))
+			break ;
+		if (!ft_ring_sleep(&ring->space_seq, seq, &ring->space_wait, \
+			&ring->consumer))
+			return (0);
+	}
+	*data = ring->data + (head & (RING_SIZE - 1));
+	head = RING_SIZE - (head & (RING_SIZE - 1));
+	return (room < head ? room : head);
+}
+
+// Function to hand len bytes written at the reserved spot to the consumer
+void ft_ring_publish(t_ring *ring, size_t len)
+{
+	__atomic_store_n(&ring->head, ring->head + len, __ATOMIC_RELEASE);
+	ft_ring_wake(&ring->data_seq, &ring->data_wait);
+}
+
+// Function to give len bytes read at the peeked spot back to the producer
+void ft_ring_consume(t_ring *ring, size_t len)
+{
+	__atomic_store_n(&ring->tail, ring->tail + len, __ATOMIC_RELEASE);
+	ft_ring_wake(&ring->space_seq, &ring->space_wait);
+}
+
+// Function to leave a ring: the producer is done, or the consumer is gone
+void ft_ring_close(t_ring *ring, int producer)
+{
+	__atomic_store_n(producer ? &ring->done : &ring->gone, 1, \
+		__ATOMIC_RELEASE);
+	if (producer)
+		ft_ring_wake(&ring->data_seq, &ring->data_wait);
+	else
+		ft_ring_wake(&ring->space_seq, &ring->space_wait);
+}
+
+// Function to leave the rings a stage still holds when it exits early (a
+// redirection that fails): the other side need not wait to see it dead
+void ft_ring_exit(void)
+{
+	if (g_shell.ring_in)
+		ft_ring_close(g_shell.ring_in, 0);
+	if (g_shell.ring_out)
+		ft_ring_close(g_shell.ring_out, 1);
+}
+
+// Function to drop the ring side a redirection replaces before it is
+// applied: "<" (or "<<<") stands for the input, ">" (">>") for the output
+void ft_ring_redirects(char **arg, int arg_count)
+{
+	int index, kind;
+
+	for (index = 0; index < arg_count; index += 2)
+	{
+		kind = ft_redirection(arg[index]);
+		if ((kind == REDIR_IN || kind == REDIR_HERE) && g_shell.ring_in)
+			ft_ring_close(g_shell.ring_in, 0), g_shell.ring_in = NULL;
+		if ((kind == REDIR_OUT || kind == REDIR_APPEND) && g_shell.ring_out)
+			ft_ring_close(g_shell.ring_out, 1), g_shell.ring_out = NULL;
+	}
+}
+
+// Function to be a copy stage with a ring on one side or both: bytes go
+// straight from the fd into the ring, or from the ring to the fd, in one
+// copy; a consumer that left is a broken pipe, so SIGPIPE as with a pipe
+void ft_ring_copy(t_ring *in, t_ring *out)
+{
+	char *src, *dst;
+	size_t len, room = 1;
+	ssize_t done = 0;
+
+	while ((len = in ? ft_ring_peek(in, &src) : RING_CHUNK) && \
+		(room = out ? ft_ring_reserve(out, &dst) : len))
+	{
+		len = len < room ? len : room;
+		len = len < RING_CHUNK ? len : RING_CHUNK;
+		if (!in && (done = read(STDIN_FILENO, dst, len)) == -1 \
+			&& errno == EINTR)
+			continue ;
+		if (!in && done <= 0)
+			break ;
+		if (!in)
+			len = done;
+		else if (out)
+			memcpy(dst, src, len);
+		else
+			ft_write_all(STDOUT_FILENO, src, len);
+		if (in)
+			ft_ring_consume(in, len);
+		if (out)
+			ft_ring_publish(out, len);
+	}
+	if (in)
+		ft_ring_close(in, 0);
+	if (out)
+		ft_ring_close(out, 1);
+	if (!room)
+		signal(SIGPIPE, SIG_DFL), raise(SIGPIPE);
+	exit(done == -1 ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+// Function to be a stage made only of redirections: copy stdin to stdout
+// inside the kernel (splice, else sendfile), read/write as a last resort;
+// a ring on either side takes the place of that fd
+void ft_exec_copy(void)
+{
+	char buf[RELAY_CHUNK];
+	ssize_t done;
+
+	ft_drop_prepared();
+	if (g_shell.ring_in || g_shell.ring_out)
+		ft_ring_copy(g_shell.ring_in, g_shell.ring_out);
+	posix_fadvise(STDIN_FILENO, 0, 0, POSIX_FADV_SEQUENTIAL);
+	while ((done = splice(STDIN_FILENO, NULL, STDOUT_FILENO, NULL, \
+		RELAY_CHUNK, SPLICE_F_MOVE)) > 0)
+		;
+	if (done == -1 && errno == EINVAL)
+		while ((done = sendfile(STDOUT_FILENO, STDIN_FILENO, NULL, \
+			RELAY_CHUNK)) > 0)
+			;
+	if (done == -1 && errno == EINVAL)
+		while ((done = read(STDIN_FILENO, buf, sizeof(buf))) > 0)
+			ft_write_all(STDOUT_FILENO, buf, done);
+	exit(done == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+// Function to read a stage's input: from its ring, or from stdin
+ssize_t ft_stage_read(char *buf, size_t len)
+{
+	char *data;
+	size_t got;
+
+	if (!g_shell.ring_in)
+		return (read(STDIN_FILENO, buf, len));
+	if (!(got = ft_ring_peek(g_shell.ring_in, &data)))
+		return (0);
+	got = got < len ? got : len;
+	memcpy(buf, data, got);
+	ft_ring_consume(g_shell.ring_in, got);
+	return (got);
+}
+
+// Function to write a stage's output: into its ring, or to stdout; a ring
+// whose consumer left is a broken pipe
+void ft_stage_write(char *buf, size_t len)
+{
+	char *room;
+	size_t step;
+
+	if (!g_shell.ring_out)
+		return (ft_write_all(STDOUT_FILENO, buf, len));
+	for (; len; buf += step, len -= step)
+	{
+		if (!(step = ft_ring_reserve(g_shell.ring_out, &room)))
+			signal(SIGPIPE, SIG_DFL), raise(SIGPIPE), exit(EXIT_FAILURE);
+		step = step < len ? step : len;
+		memcpy(room, buf, step);
+		ft_ring_publish(g_shell.ring_out, step);
+	}
+}
+
+// Function to compare the needle with the bytes at s (folded with -i)
+static inline int ft_grep_needle(t_grep *g, const char *s)
+{
+	const char *needle = g->pat + g->needle;
+	int index;
+
+	if (!g->icase)
+		return (!memcmp(s, needle, g->needle_len));
+	for (index = 0; index < g->needle_len; index++)
+		if (ft_lower(s[index]) != (unsigned char)needle[index])
+			return (0);
+	return (1);
+}
+
+// Function to find the first place the needle may start in s[0..n),
+// n if none: memmem, or a byte loop with -i
+size_t ft_grep_find_scalar(t_grep *g, const char *s, size_t n)
+{
+	const char *hit;
+	size_t index;
+
+	if (!g->icase)
+		return ((hit = memmem(s, n, g->pat + g->needle, g->needle_len)) ? \
+			(size_t)(hit - s) : n);
+	for (index = 0; index + g->needle_len <= n; index++)
+		if (ft_grep_needle(g, s + index))
+			return (index);
+	return (n);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// Function to find the needle 16 bytes at a time: lanes equal to its first
+// byte whose lane m - 1 further on equals its last byte are candidates,
+// checked in full (with -i a letter is compared with bit 5 forced on)
+__attribute__((target("sse2")))
+size_t ft_grep_find_sse2(t_grep *g, const char *s, size_t n)
+{
+	const unsigned char *needle = (unsigned char *)g->pat + g->needle;
+	size_t m = g->needle_len, index = 0;
+	int fold_f = g->icase && (unsigned)(needle[0] - 'a') < 26, \
+		fold_l = g->icase && (unsigned)(needle[m - 1] - 'a') < 26;
+	__m128i first = _mm_set1_epi8(needle[0]), last = _mm_set1_epi8(\
+		needle[m - 1]), fold_first = _mm_set1_epi8(fold_f ? 0x20 : 0), \
+		fold_last = _mm_set1_epi8(fold_l ? 0x20 : 0);
+	unsigned mask;
+
+	for (; index + m - 1 + 16 <= n; index += 16)
+	{
+		mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(first, \
+			_mm_or_si128(_mm_loadu_si128((const __m128i *)(s + index)), \
+			fold_first)), _mm_cmpeq_epi8(last, _mm_or_si128(\
+			_mm_loadu_si128((const __m128i *)(s + index + m - 1)), \
+			fold_last))));
+		for (; mask; mask &= mask - 1)
+			if (ft_grep_needle(g, s + index + __builtin_ctz(mask)))
+				return (index + __builtin_ctz(mask));
+	}
+	return (index + ft_grep_find_scalar(g, s + index, n - index));
+}
+
+// Function to do the same as ft_grep_find_sse2, 32 bytes at a time
+__attribute__((target("avx2")))
+size_t ft_grep_find_avx2(t_grep *g, const char *s, size_t n)
+{
+	const unsigned char *needle = (unsigned char *)g->pat + g->needle;
+	size_t m = g->needle_len, index = 0;
+	int fold_f = g->icase && (unsigned)(needle[0] - 'a') < 26, \
+		fold_l = g->icase && (unsigned)(needle[m - 1] - 'a') < 26;
+	__m256i first = _mm256_set1_epi8(needle[0]), last = _mm256_set1_epi8(\
+		needle[m - 1]), fold_first = _mm256_set1_epi8(fold_f ? 0x20 : 0), \
+		fold_last = _mm256_set1_epi8(fold_l ? 0x20 : 0);
+	unsigned mask;
+
+	for (; index + m - 1 + 32 <= n; index += 32)
+	{
+		mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(first, \
+			_mm256_or_si256(_mm256_loadu_si256((const __m256i *)(s + index)), \
+			fold_first)), _mm256_cmpeq_epi8(last, _mm256_or_si256(\
+			_mm256_loadu_si256((const __m256i *)(s + index + m - 1)), \
+			fold_last))));
+		for (; mask; mask &= mask - 1)
+			if (ft_grep_needle(g, s + index + __builtin_ctz(mask)))
+				return (index + __builtin_ctz(mask));
+	}
+	return (index + ft_grep_find_scalar(g, s + index, n - index));
+}
+
+#endif
+
+// Function to pick the needle search once, at run time: AVX2 if the CPU
+// has it, else SSE2, else scalar; --simd caps the choice
+void ft_grep_pick(t_grep *g)
+{
+	g->find = ft_grep_find_scalar;
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_cpu_init();
+	if (g_shell.simd != SIMD_SCALAR && __builtin_cpu_supports("sse2"))
+		g->find = ft_grep_find_sse2;
+	if ((g_shell.simd == SIMD_AUTO || g_shell.simd == SIMD_AVX2) && \
+		__builtin_cpu_supports("avx2"))
+		g->find = ft_grep_find_avx2;
+#endif
+}
+
+// Function to match the whole pattern at s, which has g->len bytes
+static inline int ft_grep_at(t_grep *g, const char *s)
+{
+	int index;
+
+	for (index = 0; index < g->len; index++)
+		if (!g->any[index] && (unsigned char)g->pat[index] != \
+			(g->icase ? ft_lower(s[index]) : (unsigned char)s[index]))
+			return (0);
+	return (1);
+}
+
+// Function to tell whether a line (without its newline) matches
+int ft_grep_line(t_grep *g, const char *line, size_t len)
+{
+	size_t pos;
+
+	if (len < (size_t)g->len)
+		return (0);
+	if (g->start)
+		return (ft_grep_at(g, line) && (!g->end || len == (size_t)g->len));
+	if (g->end)
+		return (ft_grep_at(g, line + len - g->len));
+	for (pos = 0; pos + g->len <= len; pos++)
+		if (ft_grep_at(g, line + pos))
+			return (1);
+	return (0);
+}
+
+// Function to flush what grep has buffered for its output
+void ft_grep_flush(t_grep *g)
+{
+	ft_stage_write(g->out, g->out_len);
+	g->out_len = 0;
+}
+
+// Function to output selected lines; once the input was seen to be binary
+// (a NUL byte), GNU grep's one-line notice replaces them and grep stops
+void ft_grep_select(t_grep *g, const char *data, size_t len)
+{
+	if (!len || g->count)
+		return ;
+	g->selected = 1;
+	if (g->binary)
+		ft_grep_flush(g), ft_print_error(g->name), \
+		ft_print_error(": (standard input): binary file matches\n"), \
+		exit(EXIT_SUCCESS);
+	if (g->out_len + len > GREP_OUT)
+		ft_grep_flush(g);
+	if (len >= GREP_OUT)
+		return (ft_stage_write((char *)data, len));
+	memcpy(g->out + g->out_len, data, len);
+	g->out_len += len;
+}
+
+// Function to run grep over whole lines s[0..len): the needle search skips
+// to the next line that may match, which is then checked in full; with -v
+// the stretches between matching lines are output as they are
+void ft_grep_block(t_grep *g, const char *s, size_t len)
+{
+	size_t pos = 0, span = 0, hit, start, stop;
+	const char *at;
+
+	while (pos < len)
+	{
+		hit = g->needle_len ? pos + g->find(g, s + pos, len - pos) : pos;
+		if (hit >= len)
+			break ;
+		start = (at = memrchr(s + pos, '\n', hit - pos)) ? (size_t)(at - s) + 1 \
+			: pos;
+		stop = (const char *)memchr(s + hit, '\n', len - hit) - s;
+		pos = stop + 1;
+		if (!ft_grep_line(g, s + start, stop - start))
+			continue ;
+		g->matched++;
+		if (g->invert)
+			ft_grep_select(g, s + span, start - span), span = pos;
+		else
+			ft_grep_select(g, s + start, pos - start);
+	}
+	if (g->invert)
+		ft_grep_select(g, s + span, len - span);
+	for (at = s; g->invert && g->count && \
+		(at = memchr(at, '\n', s + len - at)); at++)
+		g->lines++;
+}
+
+// Function to be a grep stage (grep [-vciF] pattern), reading stdin in
+// GNU grep's read size and doing what GNU grep does at the edges: a last
+// line without a newline gets one, NUL bytes end lines once the input is
+// binary, and -v with an empty pattern exits at once, even with -c.
+// Exits 0 when a line was selected, 1 if none, 2 on error
+void ft_exec_grep(char **arg, int arg_count)
+{
+	t_grep g = {0};
+	char *buf, *last = NULL, *nul;
+	size_t cap = GREP_BUF, fill = 0, end;
+	ssize_t got = 1;
+	long long selected;
+
+	ft_drop_prepared();
+	ft_grep_args(arg, arg_count, &g);
+	ft_grep_pick(&g);
+	g.name = *arg;
+	if (g.invert && !g.len && !g.start && !g.end)
+		exit(EXIT_FAILURE);
+	if (!(buf = malloc(cap)) || !(g.out = malloc(GREP_OUT)))
+		ft_exit_fatal();
+	while (got)
+	{
+		if (cap - fill <= GREP_READ && !(buf = realloc(buf, cap *= 2)))
+			ft_exit_fatal();
+		if ((got = ft_stage_read(buf + fill, GREP_READ)) == -1 && \
+			errno == EINTR)
+			continue ;
+		if (got == -1)
+			ft_print_error(g.name), \
+			ft_print_error(": (standard input): read error\n"), exit(2);
+		g.binary |= got && memchr(buf + fill, '\0', got) != NULL;
+		for (nul = buf + fill; g.binary && \
+			(nul = memchr(nul, '\0', buf + fill + got - nul)); nul++)
+			*nul = '\n';
+		last = got ? memrchr(buf + fill, '\n', got) : NULL;
+		if (!(fill += got) || (got && !last))
+			continue ;
+		if (!got && buf[fill - 1] != '\n')
+			buf[fill++] = '\n';
+		end = got ? (size_t)(last - buf) + 1 : fill;
+		ft_grep_block(&g, buf, end);
+		memmove(buf, buf + end, fill -= end);
+	}
+	ft_grep_flush(&g);
+	selected = g.invert ? g.lines - g.matched : g.matched;
+	if (g.count)
+		g.out_len = snprintf(g.out, GREP_OUT, "%lld\n", selected), \
+		ft_grep_flush(&g);
+	exit(g.count ? selected == 0 : !g.selected);
+}
+
+// Function to tell a blank (a field separator without -t) in the C locale
+static inline int ft_sort_blank(char c)
+{
+	return (c == ' ' || c == '\t');
+}
+
+// Function to find where key starts in the line p[0..lim), as GNU sort's
+// begfield: skip sword fields (with their leading blanks, or up to and
+// past a -t char), the blanks with b, then schar characters
+const char *ft_sort_begin(t_sort *s, t_key *key, const char *p, \
+	const char *lim)
+{
+	size_t word = key->sword;
+
+	while (p < lim && word--)
+	{
+		if (s->tab != -1)
+		{
+			while (p < lim && (unsigned char)*p != s->tab)
+				p++;
+			p += p < lim;
+			continue ;
+		}
+		while (p < lim && ft_sort_blank(*p))
+			p++;
+		while (p < lim && !ft_sort_blank(*p))
+			p++;
+	}
+	while (key->skip_start && p < lim && ft_sort_blank(*p))
+		p++;
+	return ((size_t)(lim - p) > key->schar ? p + key->schar : lim);
+}
+
+// Function to find where key ends in the line p[0..lim), as GNU sort's
+// limfield: with no end char the whole end field, -t char excluded
+const char *ft_sort_limit(t_sort *s, t_key *key, const char *p, \
+	const char *lim)
+{
+	size_t word = key->eword + !key->echar;
+
+	while (p < lim && word--)
+	{
+		if (s->tab != -1)
+		{
+			while (p < lim && (unsigned char)*p != s->tab)
+				p++;
+			p += p < lim && (word || key->echar);
+			continue ;
+		}
+		while (p < lim && ft_sort_blank(*p))
+			p++;
+		while (p < lim && !ft_sort_blank(*p))
+			p++;
+	}
+	if (!key->echar)
+		return (p);
+	while (key->skip_end && p < lim && ft_sort_blank(*p))
+		p++;
+	return ((size_t)(lim - p) > key->echar ? p + key->echar : lim);
+}
+
+// Function to read a number as sort -n does in the C locale: blanks, an
+// optional "-", digits and a "." fraction, no grouping. Leading zeros of
+// the integer and trailing ones of the fraction are dropped; returns the
+// sign, 0 for zero (no digits, or "-0", is zero too)
+int ft_sort_number(const char *p, const char *lim, const char **digits, \
+	size_t *whole, size_t *fraction)
+{
+	const char *at;
+	int negative;
+
+	while (p < lim && ft_sort_blank(*p))
+		p++;
+	if ((negative = p < lim && *p == '-'))
+		p++;
+	while (p < lim && *p == '0')
+		p++;
+	for (*digits = p; p < lim && (unsigned)(*p - '0') <= 9; p++)
+		;
+	*whole = p - *digits, *fraction = 0;
+	if (p < lim && *p == '.')
+		for (at = ++p; p < lim && (unsigned)(*p - '0') <= 9; p++)
+			if (*p != '0')
+				*fraction = p + 1 - at;
+	if (!*whole && !*fraction)
+		return (0);
+	return (negative ? -1 : 1);
+}
+
+// Function to compare two numbers (-n); the fraction starts one byte past
+// the integer digits when there is one
+int ft_sort_numeric(const char *a, const char *lima, const char *b, \
+	const char *limb)
+{
+	size_t whole_a, whole_b, frac_a, frac_b;
+	const char *da, *db;
+	int sign, diff;
+
+	sign = ft_sort_number(a, lima, &da, &whole_a, &frac_a);
+	if ((diff = sign - ft_sort_number(b, limb, &db, &whole_b, &frac_b)))
+		return (diff < 0 ? -1 : 1);
+	if (!sign)
+		return (0);
+	if (whole_a != whole_b)
+		return (whole_a < whole_b ? -sign : sign);
+	if ((diff = memcmp(da, db, whole_a)))
+		return (diff < 0 ? -sign : sign);
+	da += whole_a + 1, db += whole_b + 1;
+	if ((diff = memcmp(da, db, frac_a < frac_b ? frac_a : frac_b)))
+		return (diff < 0 ? -sign : sign);
+	return (frac_a == frac_b ? 0 : frac_a < frac_b ? -sign : sign);
+}
+
+// Function to compare two byte strings as the C locale does
+static inline int ft_sort_bytes(const char *a, size_t lena, const char *b, \
+	size_t lenb)
+{
+	int diff;
+
+	if (!lena || !lenb)
+		return ((lena != 0) - (lenb != 0));
+	diff = memcmp(a, b, lena < lenb ? lena : lenb);
+	return (diff ? diff : (lena > lenb) - (lena < lenb));
+}
+
+// Function to find the span of key in the line p[0..len); a key that
+// ends before it starts is empty
+static inline void ft_sort_span(t_sort *s, t_key *key, const char *p, \
+	size_t len, const char **span)
+{
+	span[0] = ft_sort_begin(s, key, p, p + len);
+	span[1] = key->to_end ? p + len : ft_sort_limit(s, key, p, p + len);
+	span[1] = span[1] < span[0] ? span[0] : span[1];
+}
+
+// Function to fill in a view's first key, for a line just read
+static inline void ft_sort_view(t_sort *s, t_view *view)
+{
+	const char *span[2] = {NULL, NULL};
+
+	if (s->keys)
+		ft_sort_span(s, s->key, view->text, view->len, span);
+	view->key = span[0], view->lim = span[1];
+}
+
+// Function to compare two lines the way GNU sort does: key by key, then,
+// unless -u, the whole lines, reversed by the global -r
+int ft_sort_compare(t_sort *s, t_view *a, t_view *b)
+{
+	const char *ta[2] = {a->key, a->lim}, *tb[2] = {b->key, b->lim};
+	t_key *key;
+	int diff;
+
+	for (key = s->key; key < s->key + s->keys; key++)
+	{
+		if (key != s->key)
+			ft_sort_span(s, key, a->text, a->len, ta), \
+			ft_sort_span(s, key, b->text, b->len, tb);
+		if (key->numeric)
+			diff = ft_sort_numeric(ta[0], ta[1], tb[0], tb[1]);
+		else
+			diff = ft_sort_bytes(ta[0], ta[1] - ta[0], tb[0], tb[1] - tb[0]);
+		if (diff)
+			return (key->reverse ? -diff : diff);
+	}
+	if (s->keys && s->unique)
+		return (0);
+	diff = ft_sort_bytes(a->text, a->len, b->text, b->len);
+	return (s->reverse ? -diff : diff);
+}
+
+// Function to sum up a line's first key (the line without keys) in 64
+// bits that compare as it does, before -r: its first 8 bytes big-endian;
+// with -n a sign class, then the digit count and the first 12 digits
+// (inverted when negative). A different prefix decides, an equal one
+// leaves it to ft_sort_compare
+uint64_t ft_sort_prefix(t_sort *s, t_view *view)
+{
+	const char *p = s->keys ? view->key : view->text, *digits;
+	size_t len = s->keys ? (size_t)(view->lim - p) : view->len, whole, frac;
+	uint64_t prefix = 0;
+	int index, sign, shift = 44;
+
+	if (!s->keys || !s->key->numeric)
+	{
+		for (index = 0; index < 8; index++)
+			prefix = prefix << 8 | (index < (int)len ? \
+				(unsigned char)p[index] : 0);
+		return (prefix);
+	}
+	if (!(sign = ft_sort_number(p, p + len, &digits, &whole, &frac)))
+		return (1ULL << 62);
+	prefix = (uint64_t)(whole < 16383 ? whole : 16383) << 48;
+	for (index = 0; index < (int)(whole + frac + (frac > 0)) && shift >= 0; \
+		index++)
+		if (digits[index] != '.')
+			prefix |= (uint64_t)(digits[index] - '0') << shift, shift -= 4;
+	return (sign > 0 ? 2ULL << 62 | prefix : ~prefix & ((1ULL << 62) - 1));
+}
+
+// Function to compare two lines of the arena, on their prefixes first
+static inline int ft_sort_lines(t_sort *s, t_line *a, t_line *b)
+{
+	t_view va = {s->base + a->off, a->len, s->base + a->key, \
+		s->base + a->key + a->key_len};
+	t_view vb = {s->base + b->off, b->len, s->base + b->key, \
+		s->base + b->key + b->key_len};
+
+	if (a->prefix != b->prefix)
+		return ((a->prefix < b->prefix) == !(s->keys ? s->key->reverse : \
+			s->reverse) ? -1 : 1);
+	return (ft_sort_compare(s, &va, &vb));
+}
+
+// Function to sort count lines stably: a merge sort whose left halves are
+// copied to tmp to be merged back, insertion sort on short slices, and no
+// merge at all when the halves are already in order
+void ft_sort_range(t_sort *s, t_line *line, t_line *tmp, size_t count)
+{
+	size_t half = count / 2, left = 0, right = half, out = 0;
+	t_line moved;
+
+	if (count <= 16)
+	{
+		for (right = 1; right < count; right++)
+		{
+			moved = line[right];
+			for (out = right; out && ft_sort_lines(s, &line[out - 1], \
+				&moved) > 0; out--)
+				line[out] = line[out - 1];
+			line[out] = moved;
+		}
+		return ;
+	}
+	ft_sort_range(s, line, tmp, half);
+	ft_sort_range(s, line + half, tmp + half, count - half);
+	if (ft_sort_lines(s, &line[half - 1], &line[half]) <= 0)
+		return ;
+	memcpy(tmp, line, half * sizeof(t_line));
+	while (left < half && right < count)
+		line[out++] = ft_sort_lines(s, &line[right], &tmp[left]) < 0 ? \
+			line[right++] : tmp[left++];
+	memcpy(line + out, tmp + left, (half - left) * sizeof(t_line));
+}
+
+// Function to be one sorting thread: find the first key of each of its
+// lines and its prefix, then sort them
+void *ft_sort_worker(void *data)
+{
+	t_part *part = data;
+	t_sort *s = part->sort;
+	t_line *line;
+	t_view view;
+
+	for (line = part->line; line < part->line + part->count; line++)
+	{
+		view.text = s->base + line->off, view.len = line->len;
+		ft_sort_view(s, &view);
+		if (s->keys)
+			line->key = view.key - s->base, \
+			line->key_len = view.lim - view.key;
+		line->prefix = ft_sort_prefix(s, &view);
+	}
+	ft_sort_range(s, part->line, part->tmp, part->count);
+	return (NULL);
+}
+
+// Function to sort count lines in up to --sort-threads slices at once,
+// one per thread (the calling one sorts the first); returns the slices,
+// each sorted, for the merge to join
+int ft_sort_chunk(t_sort *s, t_line *line, size_t count, t_part *part)
+{
+	int parts = s->threads, index;
+	pthread_attr_t attr;
+	t_line *tmp;
+
+	if ((size_t)parts > count / SORT_SMALL)
+		parts = count / SORT_SMALL ? count / SORT_SMALL : 1;
+	if (!(tmp = malloc((count ? count : 1) * sizeof(t_line))))
+		ft_exit_fatal();
+	pthread_attr_init(&attr);
+	pthread_attr_setstacksize(&attr, SORT_STACK);
+	for (index = parts - 1; index >= 0; index--)
+	{
+		part[index] = (t_part){s, line + count * index / parts, \
+			tmp + count * index / parts, count * (index + 1) / parts - \
+			count * index / parts, 0, 0};
+		if (index)
+			part[index].started = !pthread_create(&part[index].thread, \
+				&attr, ft_sort_worker, &part[index]);
+		if (!part[index].started)
+			ft_sort_worker(&part[index]);
+	}
+	for (index = 1; index < parts; index++)
+		if (part[index].started)
+			pthread_join(part[index].thread, NULL);
+	pthread_attr_destroy(&attr);
+	free(tmp);
+	return (parts);
+}
+
+// Function to move a merge source on to its next line; run files are read
+// SORT_RUN_BUF at a time, grown for a line longer than that. Returns 0
+// once the source has no line left
+int ft_sort_next(t_sort *s, t_source *src)
+{
+	char *nl;
+	ssize_t got;
+
+	if (src->fd == -1 && src->line < src->end)
+		return (src->view = (t_view){s->base + src->line->off, \
+			src->line->len, s->base + src->line->key, s->base + \
+			src->line->key + src->line->key_len}, src->line++, 1);
+	while (src->fd != -1)
+	{
+		if ((nl = memchr(src->buf + src->start, '\n', src->fill - src->start)))
+			return (src->view.text = src->buf + src->start, \
+				src->view.len = nl - src->view.text, \
+				src->start = nl + 1 - src->buf, ft_sort_view(s, &src->view), 1);
+		if (src->eof)
+			break ;
+		memmove(src->buf, src->buf + src->start, src->fill -= src->start);
+		src->start = 0;
+		if (src->fill == src->cap && !(src->buf = realloc(src->buf, \
+			src->cap *= 2)))
+			ft_exit_fatal();
+		if ((got = read(src->fd, src->buf + src->fill, src->cap - src->fill)) \
+			== -1 && errno != EINTR)
+			ft_exit_fatal();
+		src->eof = got == 0;
+		src->fill += got > 0 ? got : 0;
+	}
+	return (src->done = 1, 0);
+}
+
+// Function to tell whether source a comes out of the merge before source
+// b: the smaller line, the earlier source on a tie (so the merge is
+// stable), anything before a spent source; -1 stands for a source not
+// played yet while the tree is being built, and beats every other
+static inline int ft_sort_beats(t_sort *s, t_source *src, int a, int b)
+{
+	int diff;
+
+	if (a < 0 || b < 0)
+		return (a < 0);
+	if (src[a].done || src[b].done)
+		return (src[b].done && (!src[a].done || a < b));
+	diff = ft_sort_compare(s, &src[a].view, &src[b].view);
+	return (diff < 0 || (!diff && a < b));
+}
+
+// Function to replay source winner up the loser tree: each node keeps the
+// loser of the match played there and the winner goes on, so a new line
+// costs one comparison per level; tree[0] is the overall winner
+void ft_sort_replay(t_sort *s, t_source *src, int *tree, int count, \
+	int winner)
+{
+	int node, loser;
+
+	for (node = (winner + count) / 2; node > 0; node /= 2)
+		if (ft_sort_beats(s, src, tree[node], winner))
+			loser = winner, winner = tree[node], tree[node] = loser;
+	tree[0] = winner;
+}
+
+// Function to write bytes where the sink goes
+void ft_sort_write(t_sink *sink, char *buf, size_t len)
+{
+	if (sink->fd == -1)
+		ft_stage_write(buf, len);
+	else
+		ft_write_all(sink->fd, buf, len);
+}
+
+// Function to write the sink's buffer out
+void ft_sort_flush(t_sink *sink)
+{
+	ft_sort_write(sink, sink->buf, sink->len);
+	sink->len = 0;
+}
+
+// Function to output a line and its newline; with -u a line equal to the
+// last one output is dropped, so each run of equal lines keeps its first
+void ft_sort_emit(t_sort *s, t_sink *sink, t_view *view)
+{
+	const char *text = view->text;
+	size_t len = view->len;
+
+	if (s->unique && sink->has_last && !ft_sort_compare(s, \
+		&sink->last_view, view))
+		return ;
+	if (s->unique && len > sink->last_cap && !(sink->last = \
+		realloc(sink->last, sink->last_cap = len * 2)))
+		ft_exit_fatal();
+	if (s->unique)
+		memcpy(sink->last, text, len), sink->has_last = 1, \
+		sink->last_view = (t_view){sink->last, len, NULL, NULL}, \
+		ft_sort_view(s, &sink->last_view);
+	if (!sink->buf && !(sink->buf = malloc(SORT_OUT)))
+		ft_exit_fatal();
+	if (sink->len + len + 1 > SORT_OUT)
+		ft_sort_flush(sink);
+	if (len >= SORT_OUT)
+		ft_sort_write(sink, (char *)text, len), len = 0;
+	memcpy(sink->buf + sink->len, text, len);
+	sink->buf[sink->len + len] = '\n';
+	sink->len += len + 1;
+}
+
+// Function to sort a chunk of lines and merge its slices with the run
+// files (earlier input, so first on ties) into sink with a loser tree;
+// the runs are closed on the way out
+void ft_sort_output(t_sort *s, t_line *line, size_t count, int *runs, \
+	int run_count, t_sink *sink)
+{
+	t_part part[SORT_PARTS];
+	t_source *src;
+	int *tree, total = run_count, index;
+
+	if (count)
+		total += ft_sort_chunk(s, line, count, part);
+	if (!total)
+		return ;
+	if (!(src = calloc(total, sizeof(t_source))) || \
+		!(tree = malloc(total * sizeof(int))))
+		ft_exit_fatal();
+	for (index = 0; index < total; index++)
+	{
+		tree[index] = -1;
+		src[index].fd = index < run_count ? runs[index] : -1;
+		if (index >= run_count)
+			src[index].line = part[index - run_count].line, \
+			src[index].end = part[index - run_count].line + \
+				part[index - run_count].count;
+		else if (!(src[index].buf = malloc(src[index].cap = SORT_RUN_BUF)))
+			ft_exit_fatal();
+	}
+	for (index = total - 1; index >= 0; index--)
+		ft_sort_next(s, &src[index]), \
+		ft_sort_replay(s, src, tree, total, index);
+	while (total && !src[tree[0]].done)
+	{
+		ft_sort_emit(s, sink, &src[tree[0]].view);
+		ft_sort_next(s, &src[tree[0]]);
+		ft_sort_replay(s, src, tree, total, tree[0]);
+	}
+	for (index = 0; index < run_count; index++)
+		close(runs[index]), free(src[index].buf);
+	free(src), free(tree);
+}
+
+// Function to sort lines or merge runs into a new run file in dir (an
+// unnamed O_TMPFILE, else a mkstemp name unlinked at once), returns its
+// fd rewound for reading
+int ft_sort_spill(t_sort *s, t_line *line, size_t count, int *runs, \
+	int run_count)
+{
+	t_sink sink = {.fd = -1};
+	char path[4096], *dir = s->tmpdir;
+
+	if ((sink.fd = open(dir, O_TMPFILE | O_RDWR | O_CLOEXEC, 0600)) == -1 \
+		&& snprintf(path, sizeof(path), "%s/msh-sortXXXXXX", dir) > 0 && \
+		(sink.fd = mkstemp(path)) != -1)
+		unlink(path);
+	if (sink.fd == -1)
+		ft_print_error(s->name), \
+		ft_print_error(": cannot create temporary file in '"), \
+		ft_print_error(dir), ft_print_error("': "), \
+		ft_print_error(strerror(errno)), ft_print_error("\n"), exit(2);
+	ft_sort_output(s, line, count, runs, run_count, &sink);
+	ft_sort_flush(&sink);
+	free(sink.buf), free(sink.last);
+	if (lseek(sink.fd, 0, SEEK_SET) == -1)
+		ft_exit_fatal();
+	return (sink.fd);
+}
+
+// Function to set the budget of a sort stage: --sort-mem, but no more than
+// a quarter of an address space limit (limit as=), and --sort-threads or
+// the CPUs the stage may run on, up to SORT_THREADS
+void ft_sort_budget(t_sort *s)
+{
+	struct rlimit limit;
+	cpu_set_t allowed;
+
+	s->mem = g_shell.sort_mem > 0 ? g_shell.sort_mem : SORT_MEM;
+	if (!getrlimit(RLIMIT_AS, &limit) && limit.rlim_cur != RLIM_INFINITY \
+		&& limit.rlim_cur / 4 < s->mem)
+		s->mem = limit.rlim_cur / 4;
+	s->threads = g_shell.sort_threads;
+	if (s->threads <= 0 && !sched_getaffinity(0, sizeof(allowed), &allowed))
+		s->threads = CPU_COUNT(&allowed);
+	if (s->threads <= 0 || (!g_shell.sort_threads && \
+		s->threads > SORT_THREADS))
+		s->threads = g_shell.sort_threads ? 1 : SORT_THREADS;
+	if (s->threads > SORT_PARTS)
+		s->threads = SORT_PARTS;
+}
+
+// Function to be a sort stage: stdin is read into an arena and indexed
+// line by line; when the arena and its index reach the budget, the chunk
+// is sorted on the threads and spilled to a run file in $TMPDIR (or
+// /tmp), SORT_FANIN runs being first merged into one. At the end the last
+// chunk is sorted and merged with the runs straight to the output. Exits
+// 0, or 2 on error
+void ft_exec_sort(char **arg, int arg_count, char **env)
+{
+	t_sort s;
+	t_sink sink = {.fd = -1};
+	t_line *line = NULL;
+	size_t cap = SORT_READ * 8, fill = 0, start = 0, count = 0, room = 0;
+	int runs[SORT_FANIN], run_count = 0;
+	ssize_t got = 1;
+	char *nl;
+
+	ft_drop_prepared();
+	ft_sort_args(arg, arg_count, &s);
+	ft_sort_budget(&s);
+	for (s.tmpdir = "/tmp"; env && *env; env++)
+		if (!strncmp(*env, "TMPDIR=", 7) && (*env)[7])
+			s.tmpdir = *env + 7;
+	if (!(s.base = malloc(cap)))
+		ft_exit_fatal();
+	while (got)
+	{
+		if (cap - fill < SORT_READ && !(s.base = realloc(s.base, cap *= 2)))
+			ft_exit_fatal();
+		if ((got = ft_stage_read(s.base + fill, SORT_READ)) == -1 && \
+			errno == EINTR)
+			continue ;
+		if (got == -1)
+			ft_print_error(s.name), \
+			ft_print_error(": read failed: -\n"), exit(2);
+		for (nl = s.base + fill; (nl = got ? memchr(nl, '\n', \
+			s.base + fill + got - nl) : NULL) || (!got && start < fill); \
+			start = (nl ? ++nl : s.base + fill) - s.base)
+		{
+			if (count == room && !(line = realloc(line, (room = room * 2 + \
+				SORT_READ) * sizeof(t_line))))
+				ft_exit_fatal();
+			line[count++] = (t_line){start, (nl ? nl : s.base + fill) - \
+				s.base - start, start, 0, 0};
+		}
+		fill += got;
+		if (!got || !count || fill + count * 2 * sizeof(t_line) < s.mem)
+			continue ;
+		if (run_count == SORT_FANIN)
+			runs[0] = ft_sort_spill(&s, NULL, 0, runs, run_count), \
+			run_count = 1;
+		runs[run_count++] = ft_sort_spill(&s, line, count, NULL, 0);
+		memmove(s.base, s.base + start, fill -= start);
+		start = 0, count = 0;
+	}
+	ft_sort_output(&s, line, count, runs, run_count, &sink);
+	ft_sort_flush(&sink);
+	exit(EXIT_SUCCESS);
+}
+
+// Function to run a single command in the current (child) process; a
+// cached executable is launched from its fd, skipping the path walk
+void ft_exec_child(char **arg, int arg_count, char **env)
+{
+	t_exec *slot;
+
+	if (g_shell.ring_in || g_shell.ring_out)
+		ft_ring_redirects(arg, arg_count), atexit(ft_ring_exit);
+	if (!(arg_count = ft_configure_redirects(arg, arg_count)))
+		ft_exec_copy();
+	if (ft_grep_args(arg, arg_count, NULL))
+		ft_exec_grep(arg, arg_count);
+	if (ft_sort_args(arg, arg_count, NULL))
+		ft_exec_sort(arg, arg_count, env);
+	if (!strcmp(*arg, "grep"))
+		execve("/usr/bin/grep", arg, env), execve("/bin/grep", arg, env);
+	if (!strcmp(*arg, "sort"))
+		execve("/usr/bin/sort", arg, env), execve("/bin/sort", arg, env);
+	if (!strcmp(*arg, "cd"))
+		exit(ft_execute_cd(arg, arg_count));
+	ft_apply_placement();
+	if (g_trace && g_shell.born)
+		ft_trace('X', "exec", getpid(), g_shell.born, \
+			ft_clock_ns() - g_shell.born, NULL);
+	ft_hist_exec();
+	MSH_PROBE2(exec, arg[0], g_shell.slot);
+	if ((slot = ft_exec_find(arg[0])) && !slot->by_path)
+		execveat(slot->fd, "", arg, env, AT_EMPTY_PATH);
+	if (!slot || slot->by_path || errno == ENOENT || errno == ESTALE)
+		execve(arg[0], arg, env);
+	MSH_PROBE2(exec_fail, arg[0], errno);
+	ft_metric(METRIC_EXEC_FAILED);
+	ft_print_error("error: cannot execute "), ft_print_error(arg[0]), \
+	ft_print_error("\n"), exit(EXIT_FAILURE);
+}
+
+// Function to read what a producer has ready into its buffer
+void ft_relay_buffer(t_producer *prod)
+{
+	ssize_t done;
+
+	while (1)
+	{
+		if (prod->cap - prod->len < RELAY_CHUNK)
+		{
+			prod->cap = prod->cap * 2 + RELAY_CHUNK;
+			if (!(prod->buf = realloc(prod->buf, prod->cap)))
+				ft_exit_fatal();
+		}
+		done = read(prod->fd, prod->buf + prod->len, RELAY_CHUNK);
+		if (done == -1 && errno == EINTR)
+			continue ;
+		if (done == -1 && errno == EAGAIN)
+			return ;
+		if (done == -1)
+			ft_exit_fatal();
+		if (done == 0)
+			return ((void)(prod->eof = 1));
+		prod->len += done;
+	}
+}
+
+// Function to move the head producer's data to stdout without copying it;
+// returns 1 when it stopped because stdout is full rather than drained
+int ft_relay_splice(t_producer *prod)
+{
+	static int no_splice;
+	struct pollfd out = {STDOUT_FILENO, POLLOUT, 0};
+	ssize_t done;
+
+	while (!no_splice)
+	{
+		done = splice(prod->fd, NULL, STDOUT_FILENO, NULL, RELAY_CHUNK, \
+			SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+		if (done == -1 && errno == EINTR)
+			continue ;
+		if (done == -1 && errno == EAGAIN)
+			return (poll(&out, 1, 0) == 0);
+		if (done == -1 && errno == EINVAL)
+			no_splice = 1;
+		else if (done == -1)
+			ft_exit_fatal();
+		else if (done == 0)
+			return (prod->eof = 1, 0);
+	}
+	ft_relay_buffer(prod);
+	ft_write_all(STDOUT_FILENO, prod->buf, prod->len);
+	prod->len = 0;
+	return (0);
+}
+
+// Function to park the head producer while stdout is full, epoll waiting
+// for room on stdout (event count) instead, or to bring it back; a parked
+// producer leaves the set, since a hung-up one is reported regardless
+int ft_relay_stall(int epfd, t_producer *prod, int current, int count, \
+	int stall)
+{
+	struct epoll_event ev;
+
+	ev.events = EPOLLIN;
+	ev.data.u32 = current;
+	if (epoll_ctl(epfd, stall ? EPOLL_CTL_DEL : EPOLL_CTL_ADD, \
+		prod[current].fd, &ev) == -1)
+		ft_exit_fatal();
+	ev.events = EPOLLOUT;
+	ev.data.u32 = count;
+	if (epoll_ctl(epfd, stall ? EPOLL_CTL_ADD : EPOLL_CTL_DEL, \
+		STDOUT_FILENO, &ev) == -1)
+		ft_exit_fatal();
+	return (stall);
+}
+
+// Function to forward only the complete lines a producer has sent so far
+void ft_relay_lines(t_producer *prod)
+{
+	char *last;
+	size_t out;
+
+	ft_relay_buffer(prod);
+	last = memrchr(prod->buf, '\n', prod->len);
+	out = prod->eof ? prod->len : 0;
+	if (!prod->eof && last)
+		out = last - prod->buf + 1;
+	ft_write_all(STDOUT_FILENO, prod->buf, out);
+	memmove(prod->buf, prod->buf + out, prod->len - out);
+	prod->len -= out;
+}
+
+// Function to run one fan-in producer (in its child) writing to out, under
+// the group's limits (not applied to the relay, which needs its fds) and
+// then those of a "limit" prefix of its own
+void ft_exec_producer(char **arg, int arg_count, char **env, int out)
+{
+	t_command producer = {arg, arg_count, SEP_END, 0, 0};
+
+	if (dup2(out, STDOUT_FILENO) == -1)
+		ft_exit_fatal();
+	ft_limit_apply();
+	g_shell.limits.set = 0;
+	ft_limit_stage(&producer);
+	ft_limit_apply();
+	ft_exec_child(producer.arg, producer.count, env);
+}
+
+// Function to start every producer of a fan-in group on its own pipe
+int ft_start_producers(char **arg, int arg_count, char **env, \
+	t_producer *prod)
+{
+	int count = 0, start = 0, index, fds[2];
+
+	while (start < arg_count)
+	{
+		index = start;
+		while (index < arg_count && ft_separator(arg[index]) == SEP_NONE)
+			index++;
+		if (index > start)
+		{
+			g_shell.job++;
+			if (pipe2(fds, O_CLOEXEC) == -1 || \
+				(prod[count].pid = ft_fork()) == -1)
+				ft_exit_fatal();
+			if (prod[count].pid == 0)
+				ft_exec_producer(arg + start, index - start, env, fds[1]);
+			close(fds[1]);
+			prod[count].fd = fds[0];
+			fcntl(fds[0], F_SETFL, O_NONBLOCK);
+			count++;
+		}
+		start = index + 1;
+	}
+	return (count);
+}
+
+// Function to move the concatenation head forward, flushing buffered output
+int ft_relay_advance(t_producer *prod, int count, int current)
+{
+	while (current < count && prod[current].eof)
+	{
+		if (++current < count)
+		{
+			ft_write_all(STDOUT_FILENO, prod[current].buf, prod[current].len);
+			prod[current].len = 0;
+		}
+	}
+	return (current);
+}
+
+// Function to drop a drained producer from the set before closing it: a
+// producer forked after it may still hold the pipe's read end until its
+// exec, so closing alone would leave epoll reporting the hang-up
+void ft_relay_close(int epfd, t_producer *prod)
+{
+	if (epoll_ctl(epfd, EPOLL_CTL_DEL, prod->fd, NULL) == -1)
+		ft_exit_fatal();
+	close(prod->fd);
+}
+
+// Function to merge the producers' outputs on stdout, in order or by line
+int ft_relay_fan_in(t_producer *prod, int count, int by_line)
+{
+	struct epoll_event ev, events[16];
+	int epfd, live, current = 0, ready, index, i, stalled = 0;
+
+	if ((epfd = epoll_create1(EPOLL_CLOEXEC)) == -1)
+		ft_exit_fatal();
+	ev.events = EPOLLIN;
+	for (i = 0; i < count; i++)
+	{
+		ev.data.u32 = i;
+		if (epoll_ctl(epfd, EPOLL_CTL_ADD, prod[i].fd, &ev) == -1)
+			ft_exit_fatal();
+	}
+	live = count;
+	while (live)
+	{
+		if ((ready = epoll_wait(epfd, events, 16, -1)) == -1 && errno != EINTR)
+			ft_exit_fatal();
+		for (i = 0; i < ready; i++)
+		{
+			index = events[i].data.u32;
+			if (index == count)
+				stalled = ft_relay_stall(epfd, prod, current, count, 0), \
+				index = current;
+			if (prod[index].eof)
+				continue ;
+			if (by_line)
+				ft_relay_lines(&prod[index]);
+			else if (index != current)
+				ft_relay_buffer(&prod[index]);
+			else if (!stalled && ft_relay_splice(&prod[index]))
+				stalled = ft_relay_stall(epfd, prod, current, count, 1);
+			if (prod[index].eof)
+				ft_relay_close(epfd, &prod[index]), live--;
+		}
+		if (!by_line)
+			current = ft_relay_advance(prod, count, current);
+	}
+	close(epfd);
+	return (ft_wait_pipeline(count ? prod[count - 1].pid : 0));
+}
+
+// Function to splice one instrumented link, timing how long the upstream
+// leaves it waiting for data (starved) and the downstream for room (blocked)
+void ft_exec_relay(int in, int out, t_link *link)
+{
+	struct pollfd wait;
+	int64_t start, since;
+	ssize_t done;
+
+	*link = (t_link){0, 0, 0, 0, 0};
+	start = ft_clock_ns();
+	signal(SIGPIPE, SIG_IGN);
+	if (fcntl(in, F_SETFL, O_NONBLOCK) == -1 || \
+		fcntl(out, F_SETFL, O_NONBLOCK) == -1)
+		ft_exit_fatal();
+	while ((done = splice(in, NULL, out, NULL, RELAY_CHUNK, \
+		SPLICE_F_MOVE | SPLICE_F_NONBLOCK)) != 0)
+	{
+		if (done > 0 && (link->bytes += done, ++link->chunks))
+			continue ;
+		if (errno != EAGAIN && errno != EINTR)
+			break ;
+		wait = (struct pollfd){in, POLLIN, 0};
+		if (poll(&wait, 1, 0) == 1)
+			wait = (struct pollfd){out, POLLOUT, 0};
+		since = ft_clock_ns();
+		poll(&wait, 1, -1);
+		*(wait.fd == in ? &link->starved : &link->blocked) += \
+			ft_clock_ns() - since;
+	}
+	link->elapsed = ft_clock_ns() - start;
+	exit(EXIT_SUCCESS);
+}
+
+// Function to put a relay between the two ends of a fresh pipe: the stage
+// still writes pipe_fds[1], and pipe_fds[0] becomes the relay's output
+void ft_interpose_relay(int *pipe_fds)
+{
+	int link[2], null_fd;
+	pid_t pid;
+
+	if (!g_links || g_shell.slot >= PIPE_LINKS || pipe2(link, O_CLOEXEC) == -1)
+		return ;
+	if ((pid = ft_fork()) == -1)
+		ft_exit_fatal();
+	if (pid == 0)
+	{
+		if ((null_fd = open("/dev/null", O_RDONLY)) == -1 || \
+			dup2(null_fd, STDIN_FILENO) == -1)
+			ft_exit_fatal();
+		close(null_fd), close(pipe_fds[1]), close(link[0]), ft_drop_prepared();
+		if (g_shell.capture_fd >= 0)
+			close(g_shell.capture_fd);
+		ft_exec_relay(pipe_fds[0], link[1], &g_links[g_shell.slot]);
+	}
+	close(pipe_fds[0]);
+	close(link[1]);
+	pipe_fds[0] = link[0];
+}
+
+// Function to print what each link of a finished pipeline went through
+void ft_pipe_report(t_command *first, int links)
+{
+	char line[512];
+	t_link *link;
+	int index;
+
+	for (index = 0; index < links && index < PIPE_LINKS; index++)
+	{
+		link = &g_links[index];
+		snprintf(line, sizeof(line), "pipe-stats: %s -> %s: %llu bytes in " \
+			"%llu chunks, %.1f MB/s, starved %.1f%%, blocked %.1f%%\n", \
+			*first[index].arg, *first[index + 1].arg, \
+			(unsigned long long)link->bytes, (unsigned long long)link->chunks, \
+			link->elapsed ? link->bytes * 1e3 / link->elapsed : 0.0, \
+			link->elapsed ? link->starved * 100.0 / link->elapsed : 0.0, \
+			link->elapsed ? link->blocked * 100.0 / link->elapsed : 0.0);
+		ft_print_error(line);
+	}
+}
+
+// Function to write merged output, dying the way a stage whose reader
+// left does when stdout is gone
+void ft_par_write(char *buf, size_t len)
+{
+	ssize_t done;
+
+	while (len)
+	{
+		if ((done = write(STDOUT_FILENO, buf, len)) == -1 && errno == EINTR)
+			continue ;
+		if (done == -1)
+			signal(SIGPIPE, SIG_DFL), raise(SIGPIPE), exit(EXIT_FAILURE);
+		buf += done;
+		len -= done;
+	}
+}
+
+// Function to start one copy of cmd on the chunk held by slot
+void ft_par_start(t_par_slot *slot, char **arg, int arg_count, char **env)
+{
+	int in[2], out[2];
+
+	if (pipe2(in, O_CLOEXEC) == -1 || pipe2(out, O_CLOEXEC) == -1 || \
+		(slot->pid = ft_fork()) == -1)
+		ft_exit_fatal();
+	if (slot->pid == 0)
+	{
+		signal(SIGPIPE, SIG_DFL);
+		if (dup2(in[0], STDIN_FILENO) == -1 || \
+			dup2(out[1], STDOUT_FILENO) == -1)
+			ft_exit_fatal();
+		ft_exec_child(arg, arg_count, env);
+	}
+	close(in[0]);
+	close(out[1]);
+	slot->in = in[1];
+	slot->out = out[0];
+	slot->off = 0;
+	fcntl(slot->in, F_SETFL, O_NONBLOCK);
+	fcntl(slot->out, F_SETFL, O_NONBLOCK);
+}
+
+// Function to move a copy's output along: straight to stdout when its
+// chunk is the oldest in flight, into its buffer otherwise
+void ft_par_drain(t_par_slot *slot, int oldest)
+{
+	ssize_t done = -1;
+
+	if (oldest)
+		done = splice(slot->out, NULL, STDOUT_FILENO, NULL, PAR_CHUNK, \
+			SPLICE_F_MOVE);
+	if (oldest && done == -1 && errno == EPIPE)
+		ft_par_write("", 1);
+	if (done == -1 && errno != EINTR)
+	{
+		if (slot->buf_cap - slot->buf_len < RELAY_CHUNK && !(slot->buf = \
+			realloc(slot->buf, slot->buf_cap = slot->buf_cap * 2 + RELAY_CHUNK)))
+			ft_exit_fatal();
+		done = read(slot->out, slot->buf + slot->buf_len, RELAY_CHUNK);
+		if (done > 0)
+			slot->buf_len += done;
+	}
+	if (done == 0)
+		close(slot->out), slot->out = -1;
+}
+
+// Function to feed a copy as much of its chunk as its pipe takes
+void ft_par_feed(t_par_slot *slot)
+{
+	ssize_t done;
+
+	done = write(slot->in, slot->data + slot->off, slot->len - slot->off);
+	if (done > 0)
+		slot->off += done;
+	if (slot->off == slot->len || (done == -1 && errno == EPIPE))
+		close(slot->in), slot->in = -1, free(slot->data), slot->data = NULL;
+}
+
+// Function to retire the oldest chunks that are done, in order; the next
+// oldest gets its buffered output written out; returns the worst code
+int ft_par_retire(t_par_slot *slots, int n, uint64_t *out_seq, int code)
+{
+	int index, status;
+
+	for (index = 0; index < n; index++)
+	{
+		if (!slots[index].pid || slots[index].seq != *out_seq)
+			continue ;
+		ft_par_write(slots[index].buf, slots[index].buf_len);
+		slots[index].buf_len = 0;
+		if (slots[index].out != -1 || slots[index].in != -1)
+			return (code);
+		waitpid(slots[index].pid, &status, 0);
+		if (ft_exit_code(status))
+			code = ft_exit_code(status);
+		free(slots[index].buf);
+		slots[index].pid = 0;
+		++*out_seq;
+		index = -1;
+	}
+	return (code);
+}
+
+// Function to cut the next chunk off the input: up to the last newline of
+// the first PAR_CHUNK bytes (or all of it at EOF); returns its length
+size_t ft_par_cut(char *fill, size_t len, int eof)
+{
+	char *nl;
+
+	if (eof || !len)
+		return (len);
+	if (len < PAR_CHUNK || !(nl = memrchr(fill, '\n', len)))
+		return (0);
+	return (nl - fill + 1);
+}
+
+// Function to run a par stage (in the child): copies of arg + 2, fed
+// line-aligned chunks as they get free, outputs merged back in order; the
+// stage's redirections are applied here, once, and never reach the copies
+void ft_exec_par(char **arg, int arg_count, char **env)
+{
+	t_par_slot slots[PAR_MAX];
+	struct pollfd fds[1 + 2 * PAR_MAX];
+	char *fill;
+	size_t fill_len = 0, fill_cap = 2 * PAR_CHUNK, cut;
+	uint64_t seq = 0, out_seq = 0;
+	int n, eof = 0, code = 0, index, nfds, active = 0;
+	ssize_t done;
+
+	arg_count = ft_configure_redirects(arg, arg_count);
+	if (arg_count < 3 || (n = atoi(arg[1])) < 1 || n > PAR_MAX)
+		ft_print_error("error: par: bad arg\n"), exit(EXIT_FAILURE);
+	for (index = 0; index < PAR_MAX; index++)
+		slots[index] = (t_par_slot){0, 0, -1, -1, NULL, 0, 0, NULL, 0, 0};
+	ft_drop_prepared();
+	signal(SIGPIPE, SIG_IGN);
+	if (!(fill = malloc(fill_cap)))
+		ft_exit_fatal();
+	while (!eof || fill_len || active)
+	{
+		for (index = 0; index < n && (cut = ft_par_cut(fill, fill_len, eof)); \
+			index++)
+		{
+			if (slots[index].pid)
+				continue ;
+			slots[index] = (t_par_slot){0, seq++, -1, -1, fill, cut, 0, NULL, 0, 0};
+			if (!(fill = malloc(fill_cap)))
+				ft_exit_fatal();
+			memcpy(fill, slots[index].data + cut, fill_len -= cut);
+			ft_par_start(&slots[index], arg + 2, arg_count - 2, env);
+			active++;
+		}
+		nfds = 0;
+		if (!eof && !ft_par_cut(fill, fill_len, 0))
+			fds[nfds++] = (struct pollfd){STDIN_FILENO, POLLIN, 0};
+		for (index = 0; index < n; index++)
+		{
+			if (slots[index].in != -1)
+				fds[nfds++] = (struct pollfd){slots[index].in, POLLOUT, 0};
+			if (slots[index].out != -1)
+				fds[nfds++] = (struct pollfd){slots[index].out, POLLIN, 0};
+		}
+		if (nfds && poll(fds, nfds, -1) == -1 && errno != EINTR)
+			ft_exit_fatal();
+		if (nfds && fds[0].fd == STDIN_FILENO && fds[0].revents)
+		{
+			if (fill_cap - fill_len < RELAY_CHUNK && \
+				!(fill = realloc(fill, fill_cap *= 2)))
+				ft_exit_fatal();
+			if ((done = read(STDIN_FILENO, fill + fill_len, RELAY_CHUNK)) > 0)
+				fill_len += done;
+			eof = done == 0 || (done == -1 && errno != EINTR);
+		}
+		for (index = 0; index < n; index++)
+		{
+			if (slots[index].in != -1)
+				ft_par_feed(&slots[index]);
+			if (slots[index].out != -1)
+				ft_par_drain(&slots[index], slots[index].seq == out_seq);
+		}
+		code = ft_par_retire(slots, n, &out_seq, code);
+		for (active = 0, index = 0; index < n; index++)
+			active += slots[index].pid != 0;
+	}
+	exit(code);
+}
+
+// Function to run a whole fan-in group as one stage (in the child)
+void ft_exec_fan_in(char **arg, int arg_count, char **env)
+{
+	t_producer *prod;
+	int count = 1, by_line = 0, index;
+
+	for (index = 0; index < arg_count; index++)
+	{
+		count += ft_separator(arg[index]) != SEP_NONE;
+		by_line |= ft_separator(arg[index]) == SEP_FAN_LINE;
+	}
+	if (!(prod = calloc(count, sizeof(*prod))))
+		ft_exit_fatal();
+	ft_drop_prepared();
+	ft_apply_placement();
+	g_shell.born = 0;
+	count = ft_start_producers(arg, arg_count, env, prod);
+	exit(ft_relay_fan_in(prod, count, by_line));
+}
+
+// Function to execute commands and handle pipes
+int ft_execute_command(t_command *cmd, char **env)
+{
+	int has_pipe, piped, pipe_fds[2], pid, empty[2];
+	int64_t start;
+	sigset_t saved;
+
+	ft_metric(METRIC_COMMANDS);
+	if (!g_shell.slot && !strcmp(*cmd->arg, "time") && !ft_time_start(cmd))
+		return (ft_time_report(0));
+	ft_limit_stage(cmd);
+	has_pipe = cmd->sep == SEP_PIPE;
+	if (!has_pipe && !cmd->fan_in && !strcmp(*cmd->arg, "cd"))
+		return (ft_time_report(ft_execute_cd(cmd->arg, cmd->count)));
+	if (!cmd->fan_in && !g_shell.no_exec_cache && strcmp(*cmd->arg, "cd") \
+		&& strcmp(*cmd->arg, "par") && !ft_redirection(*cmd->arg) && \
+		!ft_builtin_stage(cmd->arg, cmd->count))
+		ft_exec_cache(*cmd->arg);
+	g_shell.ring_out = has_pipe ? ft_ring_open(cmd) : NULL;
+	piped = has_pipe && !g_shell.ring_out;
+	if (piped && !ft_take_pipe(cmd, pipe_fds) && pipe(pipe_fds) == -1)
+		ft_exit_fatal();
+	if (piped)
+	{
+		ft_metric(METRIC_PIPES);
+		MSH_PROBE3(pipe, g_shell.slot, pipe_fds[0], pipe_fds[1]);
+	}
+	if (piped && g_trace)
+		ft_trace('i', "pipe", g_trace->pid, ft_clock_ns(), pipe_fds[1], NULL), \
+		ft_trace_count(&g_trace->fds, 2, "fds");
+	if (piped && g_shell.pipe_stats)
+		ft_interpose_relay(pipe_fds);
+	start = g_trace ? ft_clock_ns() : 0;
+	if (g_hists)
+		ft_hist_fork(*cmd->arg, &saved);
+	if ((pid = ft_fork()) == -1)
+		ft_exit_fatal();
+	if (pid == 0)
+	{
+		g_shell.born = g_trace ? ft_clock_ns() : 0;
+		if (g_hists)
+			sigprocmask(SIG_SETMASK, &saved, NULL), signal(SIGCHLD, SIG_DFL);
+		if (cmd->fan_in || !strcmp(*cmd->arg, "par"))
+			g_shell.hist_slot = -1;
+		setpgid(0, g_shell.slot ? g_shell.pgid : 0);
+		if (!g_shell.slot)
+			ft_foreground(getpid());
+		signal(SIGPIPE, SIG_DFL);
+		if ((cmd->flags & CMD_EMPTY_IN) && (pipe(empty) == -1 || \
+			close(empty[1]) == -1 || dup2(empty[0], STDIN_FILENO) == -1 || \
+			close(empty[0]) == -1))
+			ft_exit_fatal();
+		ft_configure_pipe(piped, pipe_fds, STDOUT_FILENO);
+		if (!has_pipe && g_shell.capture_fd >= 0 && \
+			dup2(g_shell.capture_fd, STDOUT_FILENO) == -1)
+			ft_exit_fatal();
+		if (!cmd->fan_in || g_shell.limit_error)
+			ft_limit_apply();
+		if (cmd->fan_in)
+			ft_exec_fan_in(cmd->arg, cmd->count, env);
+		if (!strcmp(*cmd->arg, "par"))
+			ft_exec_par(cmd->arg, cmd->count, env);
+		ft_exec_child(cmd->arg, cmd->count, env);
+	}
+	ft_trace_fork(pid, start, *cmd->arg);
+	MSH_PROBE4(fork, pid, *cmd->arg, g_shell.job, g_shell.slot);
+	ft_limit_track(pid, *cmd->arg);
+	ft_metrics_fork(pid);
+	if (g_hists && g_shell.hist_slot >= 0)
+		__atomic_store_n(&g_hists->live[g_shell.hist_slot].pid, pid, \
+			__ATOMIC_RELEASE);
+	if (g_hists)
+		sigprocmask(SIG_SETMASK, &saved, NULL);
+	if (!g_shell.slot)
+		g_shell.pgid = pid, ft_foreground(pid);
+	setpgid(pid, g_shell.pgid);
+	ft_configure_pipe(piped, pipe_fds, STDIN_FILENO);
+	ft_ring_forked(pid);
+	if (has_pipe)
+		return (0);
+	if (g_shell.capture_fd >= 0)
+		close(g_shell.capture_fd), g_shell.capture_fd = -1;
+	if (g_shell.slot && dup2(g_shell.stdin_copy, STDIN_FILENO) == -1)
+		ft_exit_fatal();
+	ft_prepare(cmd + 1, g_shell.left);
+	return (ft_time_report(ft_wait_pipeline(pid)));
+}
+
+// Function to map the trace ring and count the fds the shell starts with
+void ft_trace_open(void)
+{
+	DIR *dir;
+
+	if ((g_trace = mmap(NULL, sizeof(t_trace), PROT_READ | PROT_WRITE, \
+		MAP_SHARED | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED)
+	{
+		g_trace = NULL;
+		return ;
+	}
+	g_trace->pid = getpid();
+	if ((dir = opendir("/proc/self/fd")))
+	{
+		while (readdir(dir))
+			g_trace->fds++;
+		g_trace->fds -= 3;
+		closedir(dir);
+	}
+}
+
+// Function to read the leading --options, returns how many tokens they took
+int ft_parse_options(char **argv)
+{
+	int count = 0, fd;
+	char *mode;
+
+	while (argv[count] && !strncmp(argv[count], "--", 2))
+	{
+		if (!strcmp(argv[count], "--"))
+			return (count + 1);
+		if (!strncmp(argv[count], "--placement=", 12))
+		{
+			mode = argv[count] + 12;
+			g_shell.placement = !strcmp(mode, "compact") ? PLACE_COMPACT \
+				: !strcmp(mode, "cache") ? PLACE_CACHE \
+				: !strcmp(mode, "spread") ? PLACE_SPREAD : -1;
+			if (g_shell.placement == -1)
+				ft_print_error("error: bad placement "), ft_print_error(mode), \
+				ft_print_error("\n"), exit(EXIT_FAILURE);
+		}
+		else if (!strncmp(argv[count], "--boost=", 8))
+			g_shell.boost = atoi(argv[count] + 8);
+		else if (!strncmp(argv[count], "--daemon=", 9))
+			g_shell.daemon = argv[count] + 9;
+		else if (!strncmp(argv[count], "--jobs=", 7))
+			g_shell.jobs = atoi(argv[count] + 7);
+		else if (!strncmp(argv[count], "--cache-dir=", 12))
+			g_shell.cache_dir = argv[count] + 12;
+		else if (!strncmp(argv[count], "--cache-size=", 13))
+			g_shell.cache_size = atoll(argv[count] + 13);
+		else if (!strcmp(argv[count], "--cache-stats"))
+			g_shell.cache_stats = 1;
+		else if (!strcmp(argv[count], "--no-optimize"))
+			g_shell.no_optimize = 1;
+		else if (!strcmp(argv[count], "--dump-plan"))
+			g_shell.dump_plan = 1;
+		else if (!strcmp(argv[count], "--no-exec-cache"))
+			g_shell.no_exec_cache = 1;
+		else if (!strncmp(argv[count], "--simd=", 7))
+			g_shell.simd = !strcmp(argv[count] + 7, "scalar") ? SIMD_SCALAR \
+				: !strcmp(argv[count] + 7, "sse2") ? SIMD_SSE2 \
+				: !strcmp(argv[count] + 7, "avx2") ? SIMD_AVX2 : SIMD_AUTO;
+		else if (!strncmp(argv[count], "--sort-mem=", 11))
+			g_shell.sort_mem = atoll(argv[count] + 11);
+		else if (!strncmp(argv[count], "--sort-threads=", 15))
+			g_shell.sort_threads = atoi(argv[count] + 15);
+		else if (!strncmp(argv[count], "--ring=", 7))
+			g_shell.ring = !strcmp(argv[count] + 7, "always") ? RING_ALWAYS \
+				: !strcmp(argv[count] + 7, "off") ? RING_OFF : RING_AUTO;
+		else if (!strncmp(argv[count], "--prepare=", 10))
+			g_shell.prepare = atoi(argv[count] + 10);
+		else if (!strncmp(argv[count], "--teardown=", 11))
+			g_shell.teardown = strcmp(argv[count] + 11, "off") ? \
+				atoi(argv[count] + 11) : -1;
+		else if (!strncmp(argv[count], "--limit=", 8))
+		{
+			if (!ft_limit_parse(argv[count] + 8, &g_shell.limits))
+				ft_print_error("error: bad limit "), \
+				ft_print_error(argv[count] + 8), ft_print_error("\n"), \
+				exit(EXIT_FAILURE);
+		}
+		else if (!strncmp(argv[count], "--metrics=", 10))
+			g_shell.metrics = argv[count] + 10;
+		else if (!strncmp(argv[count], "--metrics-file=", 15))
+			g_shell.metrics_file = argv[count] + 15;
+		else if (!strcmp(argv[count], "--histograms"))
+			g_shell.histograms = 1;
+		else if (!strcmp(argv[count], "--pipe-stats"))
+			g_shell.pipe_stats = 1;
+		else if (!strncmp(argv[count], "--trace=", 8))
+			g_shell.trace = argv[count] + 8;
+		else
+			break ;
+		count++;
+	}
+	if (g_shell.placement != PLACE_NONE)
+		ft_load_topology(&g_topology);
+	if (g_shell.jobs < 1)
+		g_shell.jobs = sysconf(_SC_NPROCESSORS_ONLN);
+	if (g_shell.cache_size < 1)
+		g_shell.cache_size = CACHE_SIZE;
+	if (g_shell.prepare < 0 || g_shell.prepare > PREPARE_AHEAD)
+		g_shell.prepare = PREPARE_AHEAD;
+	if (g_shell.pipe_stats && (g_links = mmap(NULL, sizeof(t_link) * \
+		PIPE_LINKS, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, \
+		-1, 0)) == MAP_FAILED)
+		g_links = NULL;
+	if (g_shell.trace && !g_shell.daemon)
+		ft_trace_open();
+	if (g_shell.histograms)
+		ft_hist_open();
+	for (fd = 0; fd < 3 && g_shell.tty < 0 && !g_shell.daemon; fd++)
+		if (isatty(fd) && tcgetpgrp(fd) == getpgrp())
+			g_shell.tty = fd;
+	return (count);
+}
+
+// Function to mix one 64-byte block into a SHA-256 state
+void ft_sha256_block(uint32_t *state, const unsigned char *block)
+{
+	static const uint32_t k[64] = {
+		0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+		0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+		0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+		0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+		0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+		0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+		0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+		0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+		0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+		0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+		0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+	uint32_t w[64], v[8], t1, t2;
+	int i;
+
+	for (i = 0; i < 16; i++)
+		w[i] = (uint32_t)block[i * 4] << 24 | block[i * 4 + 1] << 16 \
+			| block[i * 4 + 2] << 8 | block[i * 4 + 3];
+#define ROR(x, n) ((x) >> (n) | (x) << (32 - (n)))
+	for (i = 16; i < 64; i++)
+		w[i] = w[i - 16] + (ROR(w[i - 15], 7) ^ ROR(w[i - 15], 18) \
+			^ w[i - 15] >> 3) + w[i - 7] + (ROR(w[i - 2], 17) \
+			^ ROR(w[i - 2], 19) ^ w[i - 2] >> 10);
+	memcpy(v, state, sizeof(v));
+	for (i = 0; i < 64; i++)
+	{
+		t1 = v[7] + (ROR(v[4], 6) ^ ROR(v[4], 11) ^ ROR(v[4], 25)) \
+			+ ((v[4] & v[5]) ^ (~v[4] & v[6])) + k[i] + w[i];
+		t2 = (ROR(v[0], 2) ^ ROR(v[0], 13) ^ ROR(v[0], 22)) \
+			+ ((v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]));
+		memmove(v + 1, v, sizeof(uint32_t) * 7);
+		v[4] += t1;
+		v[0] = t1 + t2;
+	}
+#undef ROR
+	for (i = 0; i < 8; i++)
+		state[i] += v[i];
+}
+
+// Function to start a SHA-256
+void ft_sha256_init(t_sha256 *ctx)
+{
+	static const uint32_t iv[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, \
+		0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+	memcpy(ctx->state, iv, sizeof(iv));
+	ctx->length = 0;
+}
+
+// Function to feed bytes to a SHA-256
+void ft_sha256_update(t_sha256 *ctx, const void *data, size_t len)
+{
+	const unsigned char *bytes = data;
+	size_t used, take;
+
+	while (len)
+	{
+		used = ctx->length % 64;
+		take = 64 - used < len ? 64 - used : len;
+		memcpy(ctx->block + used, bytes, take);
+		ctx->length += take;
+		bytes += take;
+		len -= take;
+		if (used + take == 64)
+			ft_sha256_block(ctx->state, ctx->block);
+	}
+}
+
+// Function to finish a SHA-256 into 64 hex digits
+void ft_sha256_hex(t_sha256 *ctx, char *hex)
+{
+	uint64_t bits = ctx->length * 8;
+	unsigned char pad = 0x80, size[8];
+	int i;
+
+	ft_sha256_update(ctx, &pad, 1);
+	pad = 0;
+	while (ctx->length % 64 != 56)
+		ft_sha256_update(ctx, &pad, 1);
+	for (i = 0; i < 8; i++)
+		size[i] = bits >> (56 - i * 8);
+	ft_sha256_update(ctx, size, 8);
+	for (i = 0; i < 32; i++)
+		hex[i * 2] = "0123456789abcdef"[ctx->state[i / 4] >> \
+			(28 - (i % 4) * 8) & 15], hex[i * 2 + 1] = \
+			"0123456789abcdef"[ctx->state[i / 4] >> (24 - (i % 4) * 8) & 15];
+	hex[64] = 0;
+}
+
+// Function to hash a string with its terminator, so fields cannot run together
+void ft_sha256_str(t_sha256 *ctx, const char *str)
+{
+	ft_sha256_update(ctx, str ? str : "", str ? strlen(str) + 1 : 0);
+	if (!str)
+		ft_sha256_update(ctx, "\xff", 1);
+}
+
+// Function to hash an executable's identity (inode and mtime, not content)
+void ft_sha256_exec(t_sha256 *ctx, const char *path)
+{
+	struct stat st;
+	int64_t id[5] = {0};
+
+	if (stat(path, &st) == 0)
+	{
+		id[0] = st.st_dev;
+		id[1] = st.st_ino;
+		id[2] = st.st_size;
+		id[3] = st.st_mtim.tv_sec;
+		id[4] = st.st_mtim.tv_nsec;
+	}
+	ft_sha256_str(ctx, path);
+	ft_sha256_update(ctx, id, sizeof(id));
+}
+
+// Function to hash the content of a declared input file
+void ft_sha256_file(t_sha256 *ctx, const char *path)
+{
+	char buf[RELAY_CHUNK];
+	ssize_t done;
+	int fd;
+
+	ft_sha256_str(ctx, path);
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) == -1)
+		return (ft_sha256_str(ctx, NULL));
+	while ((done = read(fd, buf, sizeof(buf))) > 0 || \
+		(done == -1 && errno == EINTR))
+		if (done > 0)
+			ft_sha256_update(ctx, buf, done);
+	close(fd);
+}
+
+// Function to hash the value (or absence) of a selected env variable
+void ft_sha256_env(t_sha256 *ctx, const char *name, char **env)
+{
+	size_t len = strlen(name);
+
+	ft_sha256_str(ctx, name);
+	while (*env && (strncmp(*env, name, len) || (*env)[len] != '='))
+		env++;
+	ft_sha256_str(ctx, *env ? *env + len + 1 : NULL);
+}
+
+// Function to pick the cache directory once, creating it if needed
+char *ft_cache_dir(char **env)
+{
+	static char dir[2048];
+	char *home = NULL;
+
+	if (g_shell.cache_dir)
+		return (mkdir(g_shell.cache_dir, 0700), g_shell.cache_dir);
+	for (; *env && !home; env++)
+		if (!strncmp(*env, "HOME=", 5))
+			home = *env + 5;
+	snprintf(dir, sizeof(dir), "%s/.cache", home ? home : "/tmp");
+	mkdir(dir, 0700);
+	strncat(dir, "/microshell", sizeof(dir) - strlen(dir) - 1);
+	mkdir(dir, 0700);
+	return (g_shell.cache_dir = dir);
+}
+
+// Function to add deltas to the shared counters, returns their new values
+t_cache_stats ft_cache_account(t_cache_stats delta)
+{
+	t_cache_stats total = {0};
+	char path[4200];
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/stats", g_shell.cache_dir);
+	if ((fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600)) == -1)
+		return (total);
+	flock(fd, LOCK_EX);
+	if (pread(fd, &total, sizeof(total), 0) != sizeof(total))
+		memset(&total, 0, sizeof(total));
+	total.hits += delta.hits;
+	total.misses += delta.misses;
+	total.stores += delta.stores;
+	total.evictions += delta.evictions;
+	total.bytes += delta.bytes;
+	if (pwrite(fd, &total, sizeof(total), 0) != sizeof(total))
+		memset(&total, 0, sizeof(total));
+	close(fd);
+	return (total);
+}
+
+// One entry seen while scanning the cache for eviction
+typedef struct s_cache_file
+{
+	char			name[72];
+	struct timespec	used;
+	off_t			size;
+}	t_cache_file;
+
+// Function to order entries least recently used first (for qsort)
+int ft_cache_older(const void *a, const void *b)
+{
+	const t_cache_file *left = a, *right = b;
+
+	if (left->used.tv_sec != right->used.tv_sec)
+		return (left->used.tv_sec < right->used.tv_sec ? -1 : 1);
+	return ((left->used.tv_nsec > right->used.tv_nsec) \
+		- (left->used.tv_nsec < right->used.tv_nsec));
+}
+
+// Function to drop least recently used entries until the cache fits in 90%
+// of --cache-size; one microshell evicts at a time, the others skip it
+void ft_cache_evict(void)
+{
+	t_cache_file *files = NULL;
+	t_cache_stats delta = {0};
+	struct dirent *ent;
+	struct stat st;
+	DIR *dir;
+	int count = 0, index, lock;
+	long long total = 0;
+
+	if ((lock = open(g_shell.cache_dir, O_RDONLY | O_CLOEXEC)) == -1)
+		return ;
+	if (flock(lock, LOCK_EX | LOCK_NB) == -1 || !(dir = fdopendir(dup(lock))))
+		return ((void)close(lock));
+	while ((ent = readdir(dir)))
+	{
+		if (strlen(ent->d_name) != 68 || strcmp(ent->d_name + 64, ".ent") \
+			|| fstatat(dirfd(dir), ent->d_name, &st, 0) == -1)
+			continue ;
+		if (!(count & (count - 1)) && !(files = realloc(files, \
+			sizeof(t_cache_file) * (count ? count * 2 : 1))))
+			ft_exit_fatal();
+		memcpy(files[count].name, ent->d_name, 69);
+		files[count].used = st.st_mtim;
+		files[count++].size = st.st_size;
+		total += st.st_size;
+	}
+	qsort(files, count, sizeof(t_cache_file), ft_cache_older);
+	delta.bytes = total - ft_cache_account(delta).bytes;
+	for (index = 0; index < count && total > g_shell.cache_size / 10 * 9; \
+		index++)
+		if (unlinkat(dirfd(dir), files[index].name, 0) == 0)
+			total -= files[index].size, delta.bytes -= files[index].size, \
+			delta.evictions++;
+	ft_cache_account(delta);
+	closedir(dir);
+	close(lock);
+	free(files);
+}
+
+// Function to replay a cache entry on stdout, returns its code or -1
+int ft_cache_replay(char *path)
+{
+	t_cache_entry head;
+	off_t offset = sizeof(head);
+	ssize_t done;
+	char buf[RELAY_CHUNK];
+	int fd;
+
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) == -1)
+		return (-1);
+	if (read(fd, &head, sizeof(head)) != sizeof(head) || \
+		head.magic != CACHE_MAGIC)
+		return (close(fd), -1);
+	futimens(fd, NULL);
+	while (offset < (off_t)(head.length + sizeof(head)))
+	{
+		done = sendfile(STDOUT_FILENO, fd, &offset, \
+			head.length + sizeof(head) - offset);
+		if (done == -1 && errno == EINTR)
+			continue ;
+		if (done == -1 && (errno == EINVAL || errno == ENOSYS))
+			while ((done = pread(fd, buf, sizeof(buf), offset)) > 0)
+				ft_write_all(STDOUT_FILENO, buf, done), offset += done;
+		if (done <= 0)
+			break ;
+	}
+	close(fd);
+	return (head.code);
+}
+
+// Function to copy the cached group's output to stdout and to the entry
+void ft_exec_tee(int in, int file)
+{
+	char buf[RELAY_CHUNK];
+	ssize_t done;
+	int failed = 0;
+
+	while ((done = read(in, buf, sizeof(buf))) != 0)
+	{
+		if (done == -1 && errno == EINTR)
+			continue ;
+		if (done == -1)
+			exit(EXIT_FAILURE);
+		ft_write_all(STDOUT_FILENO, buf, done);
+		failed |= write(file, buf, done) != done;
+	}
+	exit(failed);
+}
+
+// Function to find the command word of the stage starting at token, past
+// its leading redirections and any time, limit and par prefixes (the
+// executable that runs is behind them); returns its index
+int ft_cache_command(char **arg, int count, int token)
+{
+	while (token + 1 < count)
+	{
+		if (ft_redirection(arg[token]))
+			token += 2;
+		else if (!strcmp(arg[token], "time"))
+			token += 1 + !strcmp(arg[token + 1], "-j");
+		else if (!strcmp(arg[token], "limit"))
+			while (++token + 1 < count && strchr(arg[token], '='))
+				;
+		else if (!strcmp(arg[token], "par"))
+			token += 2;
+		else
+			break ;
+	}
+	return (token);
+}
+
+// Function to hash what a cached group depends on: cwd, every token, the
+// executables' inode/mtime, the content of the -i and "<" files and the -e
+// variables
+void ft_cache_key(t_command *cmd, int depth, char **prefix, int prefix_count, \
+	char **env, char *hex)
+{
+	t_sha256 ctx;
+	char cwd[4096], **arg;
+	int index, token, count, command;
+
+	ft_sha256_init(&ctx);
+	ft_sha256_str(&ctx, getcwd(cwd, sizeof(cwd)));
+	for (index = 1; index + 1 < prefix_count; index += 2)
+	{
+		if (!strcmp(prefix[index], "-i"))
+			ft_sha256_file(&ctx, prefix[index + 1]);
+		else
+			ft_sha256_env(&ctx, prefix[index + 1], env);
+	}
+	for (index = 0; index < depth; index++)
+	{
+		arg = cmd[index].arg;
+		count = cmd[index].count;
+		command = ft_cache_command(arg, count, 0);
+		for (token = 0; token < count; token++)
+		{
+			ft_sha256_str(&ctx, arg[token]);
+			if (token == command)
+				ft_sha256_exec(&ctx, arg[token]);
+			if (ft_redirection(arg[token]) == REDIR_IN && token + 1 < count)
+				ft_sha256_file(&ctx, arg[token + 1]);
+			if (ft_separator(arg[token]) != SEP_NONE)
+				command = ft_cache_command(arg, count, token + 1);
+		}
+		ft_sha256_str(&ctx, "|");
+	}
+	ft_sha256_hex(&ctx, hex);
+}
+
+// Function to tell whether a pipeline writes a file (">" or ">>"): what it
+// writes there is not in the captured stdout, so it cannot be replayed
+int ft_cache_writes(t_command *cmd, int depth)
+{
+	int index, token, redir;
+
+	for (index = 0; index < depth; index++)
+	{
+		for (token = 0; token + 1 < cmd[index].count; token++)
+		{
+			redir = ft_redirection(cmd[index].arg[token]);
+			if (redir == REDIR_OUT || redir == REDIR_APPEND)
+				return (1);
+			token += redir != REDIR_NONE;
+		}
+	}
+	return (0);
+}
+
+// Function to handle a "cache [-i file | -e var]... pipeline" group: replay
+// it on a hit (returns 1), or arrange for its output to be captured; cd
+// and pipelines writing files just run
+int ft_cache_lookup(t_command *cmd, int left, char **env, int *code)
+{
+	t_cache_stats delta = {0};
+	char **prefix = cmd->arg, key[65], tmp[4200];
+	int prefix_count = 1, depth, cap[2];
+
+	while (prefix_count + 1 < cmd->count && (!strcmp(prefix[prefix_count], \
+		"-i") || !strcmp(prefix[prefix_count], "-e")))
+		prefix_count += 2;
+	cmd->arg += prefix_count;
+	cmd->count -= prefix_count;
+	if (!cmd->count || !strcmp(*cmd->arg, "cd"))
+		return (0);
+	depth = ft_pipeline_depth(cmd, left);
+	if (ft_cache_writes(cmd, depth))
+		return (0);
+	ft_cache_dir(env);
+	ft_cache_key(cmd, depth, prefix, prefix_count, env, key);
+	snprintf(g_shell.entry, sizeof(g_shell.entry), "%s/%s.ent", \
+		g_shell.cache_dir, key);
+	if ((*code = ft_cache_replay(g_shell.entry)) != -1)
+		return (delta.hits = 1, ft_cache_account(delta), 1);
+	delta.misses = 1;
+	ft_cache_account(delta);
+	snprintf(tmp, sizeof(tmp), "%s.%d.tmp", g_shell.entry, getpid());
+	if ((g_shell.entry_fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, \
+		0600)) == -1 || lseek(g_shell.entry_fd, sizeof(t_cache_entry), \
+		SEEK_SET) == -1 || pipe2(cap, O_CLOEXEC) == -1 || \
+		(g_shell.tee_pid = ft_fork()) == -1)
+		ft_exit_fatal();
+	if (g_shell.tee_pid == 0)
+		close(cap[1]), ft_drop_prepared(), ft_exec_tee(cap[0], g_shell.entry_fd);
+	close(cap[0]);
+	g_shell.capture_fd = cap[1];
+	return (0);
+}
+
+// Function to publish the captured entry once its group ended: the header
+// goes in last and the rename is atomic, so readers never see a partial one
+void ft_cache_store(int code)
+{
+	t_cache_stats delta = {0};
+	t_cache_entry head = {CACHE_MAGIC, code, 0};
+	struct stat st;
+	char tmp[4200];
+
+	snprintf(tmp, sizeof(tmp), "%s.%d.tmp", g_shell.entry, getpid());
+	if (fstat(g_shell.entry_fd, &st) == 0 && code < 128 && \
+		WIFEXITED(g_shell.tee_status) && !WEXITSTATUS(g_shell.tee_status))
+	{
+		if (st.st_size > (off_t)sizeof(head))
+			head.length = st.st_size - sizeof(head);
+		if (pwrite(g_shell.entry_fd, &head, sizeof(head), 0) == sizeof(head) \
+			&& rename(tmp, g_shell.entry) == 0)
+		{
+			delta.stores = 1;
+			delta.bytes = head.length + sizeof(head);
+			if (ft_cache_account(delta).bytes > g_shell.cache_size)
+				ft_cache_evict();
+		}
+	}
+	unlink(tmp);
+	close(g_shell.entry_fd);
+	g_shell.entry_fd = -1;
+	g_shell.tee_pid = 0;
+}
+
+// Function to print the shared cache counters (--cache-stats)
+void ft_cache_report(void)
+{
+	t_cache_stats delta = {0}, total;
+	char line[256];
+
+	if (!g_shell.cache_dir)
+		return ;
+	total = ft_cache_account(delta);
+	snprintf(line, sizeof(line), "cache: %llu hits, %llu misses, %llu stores, "
+		"%llu evictions, %lld bytes\n", (unsigned long long)total.hits, \
+		(unsigned long long)total.misses, (unsigned long long)total.stores, \
+		(unsigned long long)total.evictions, (long long)total.bytes);
+	ft_print_error(line);
+}
+
+// Function to tell whether a command is a whitelisted cat or true that
+// does nothing but copy stdin to stdout (cat) or exit 0 (true)
+int ft_is_noop(t_command *cmd, int cat)
+{
+	char *path;
+
+	if (cmd->fan_in || (cmd->flags & CMD_EMPTY_IN))
+		return (0);
+	path = cmd->arg[0];
+	if (cat)
+		return ((!strcmp(path, "/bin/cat") || !strcmp(path, "/usr/bin/cat")) \
+			&& (cmd->count == 1 || (cmd->count == 2 && \
+			!strcmp(cmd->arg[1], "-"))));
+	return ((!strcmp(path, "/bin/true") || !strcmp(path, "/usr/bin/true")) \
+		&& cmd->count == 1);
+}
+
+// Function to rewrite the command index before it runs, dropping what
+// provably changes nothing observable: empty ";" runs, "cat" between two
+// pipes, and a leading "true |" (its reader gets a pipe whose write end is
+// already closed instead: still a pipe, with the same immediate EOF); a
+// lone "true" becomes a fork-free no-op
+int ft_optimize(t_command *commands, int total)
+{
+	t_command cmd;
+	int index, kept = 0, piped_in = 0, empty_in = 0;
+
+	for (index = 0; index < total; index++)
+	{
+		cmd = commands[index];
+		cmd.flags |= empty_in ? CMD_EMPTY_IN : 0;
+		empty_in = 0;
+		if (cmd.count && !piped_in && cmd.sep == SEP_PIPE && \
+			ft_is_noop(&cmd, 0))
+			empty_in = 1;
+		else if (!cmd.count || (piped_in && cmd.sep == SEP_PIPE && \
+			ft_is_noop(&cmd, 1)))
+			empty_in = cmd.flags & CMD_EMPTY_IN;
+		else
+		{
+			if (!piped_in && ft_is_noop(&cmd, 0))
+				cmd.flags |= CMD_NOOP;
+			commands[kept++] = cmd;
+		}
+		piped_in = cmd.count && cmd.sep == SEP_PIPE && !empty_in;
+	}
+	return (kept);
+}
+
+// Function to print the plan that is about to run (--dump-plan)
+void ft_dump_plan(t_command *commands, int total, int parsed)
+{
+	static char *seps[] = {"", "|", ";", "&", "&~", ""};
+	char line[64];
+	int index, token;
+
+	snprintf(line, sizeof(line), "plan: %d commands, %d elided\n", total, \
+		parsed - total);
+	ft_print_error(line);
+	for (index = 0; index < total; index++)
+	{
+		ft_print_error("  ");
+		if (commands[index].flags & CMD_EMPTY_IN)
+			ft_print_error("<empty-pipe ");
+		if (commands[index].flags & CMD_NOOP)
+			ft_print_error("(noop) ");
+		for (token = 0; token < commands[index].count; token++)
+			ft_print_error(commands[index].arg[token]), ft_print_error(" ");
+		ft_print_error(seps[commands[index].sep]);
+		ft_print_error("\n");
+	}
+}
+
+// Function to tell a daemon client how a group (or the request) ended
+void ft_send_status(int kind, int code)
+{
+	t_status frame = {FRAME_MAGIC, kind, code};
+
+	if (g_shell.status_fd >= 0)
+		send(g_shell.status_fd, &frame, sizeof(frame), MSG_NOSIGNAL);
+}
+
+// Function to tell whether env selects the C locale for characters, the
+// one where the builtin grep gives the same bytes as GNU grep
+int ft_c_locale(char **env)
+{
+	static const char *names[] = {"LC_ALL=", "LC_CTYPE=", "LANG="};
+	char *value;
+	int name, index;
+
+	for (name = 0; name < 3; name++)
+		for (index = 0; env && env[index]; index++)
+			if (!strncmp(env[index], names[name], strlen(names[name])) && \
+				*(value = env[index] + strlen(names[name])))
+				return (!strcmp(value, "C") || !strcmp(value, "POSIX"));
+	return (1);
+}
+
+// Function to execute a tokenized command line, returns the last code
+int ft_run_line(char **tokens, int count, char **env)
+{
+	t_command *commands, *cmd;
+	int index, total, parsed, code = 0, piped = 0;
+
+	MSH_PROBE1(parse_start, count);
+	g_shell.c_locale = ft_c_locale(env);
+	commands = ft_build_index(tokens, count, &total);
+	parsed = total;
+	if (!g_shell.no_optimize)
+		total = ft_optimize(commands, total);
+	MSH_PROBE2(parse_end, total, parsed - total);
+	if (g_shell.dump_plan)
+		ft_dump_plan(commands, total, parsed);
+	g_shell.stdin_copy = fcntl(STDIN_FILENO, F_DUPFD_CLOEXEC, 3);
+	if (g_shell.stdin_copy == -1)
+		ft_exit_fatal();
+	for (index = 0; index < total; index++)
+	{
+		cmd = &commands[index];
+		if (cmd->count && g_shell.boost && !g_shell.slot)
+			g_shell.depth = ft_pipeline_depth(cmd, total - index);
+		g_shell.left = total - index - 1;
+		if (cmd->flags & CMD_NOOP)
+			code = 0;
+		else if (!g_shell.slot && cmd->count && !strcmp(*cmd->arg, "cache") \
+			&& ft_cache_lookup(cmd, total - index, env, &code))
+			cmd = &commands[index += ft_pipeline_depth(cmd, total - index) - 1];
+		else if (cmd->count)
+			code = ft_execute_command(cmd, env);
+		if (g_shell.entry_fd >= 0 && cmd->sep != SEP_PIPE)
+			ft_cache_store(code);
+		if (g_links && g_shell.slot && cmd->sep != SEP_PIPE)
+			ft_pipe_report(cmd - g_shell.slot, g_shell.slot);
+		g_shell.slot = cmd->sep == SEP_PIPE ? g_shell.slot + 1 : 0;
+		g_shell.job += cmd->sep != SEP_PIPE;
+		if (piped && cmd->sep != SEP_PIPE && \
+			dup2(g_shell.stdin_copy, STDIN_FILENO) == -1)
+			ft_exit_fatal();
+		piped = cmd->sep == SEP_PIPE;
+		if (cmd->count && cmd->sep != SEP_PIPE)
+			ft_send_status(STATUS_GROUP, code);
+	}
+	ft_drop_prepared();
+	close(g_shell.stdin_copy);
+	free(commands);
+	return (code);
+}
+
+// Function to receive a request header and the fds passed along with it;
+// the client sends it in one message, so a short one is dropped, not
+// waited for
+int ft_recv_request(int fd, t_request *req, int *fds)
+{
+	union { struct cmsghdr align; char buf[CMSG_SPACE(3 * sizeof(int))]; } \
+		control;
+	struct iovec iov = {req, sizeof(*req)};
+	struct msghdr msg = {0};
+	struct cmsghdr *cmsg;
+	int count = 0;
+
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.buf;
+	msg.msg_controllen = sizeof(control.buf);
+	if (recvmsg(fd, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC) != sizeof(*req))
+		return (-1);
+	cmsg = CMSG_FIRSTHDR(&msg);
+	if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+	{
+		count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		memcpy(fds, CMSG_DATA(cmsg), count * sizeof(int));
+	}
+	if (req->magic != FRAME_MAGIC || req->length > FRAME_MAX || \
+		count != __builtin_popcount(req->fds & 7) || req->fds > 7)
+	{
+		while (count--)
+			close(fds[count]);
+		return (-1);
+	}
+	return (count);
+}
+
+// Function to split a request payload into argv and env (NULL terminated)
+char **ft_split_payload(char *payload, uint32_t length, int strings)
+{
+	char **vector;
+	uint32_t pos = 0;
+	int index;
+
+	if (length && payload[length - 1])
+		return (NULL);
+	if (!(vector = malloc(sizeof(char *) * (strings + 2))))
+		ft_exit_fatal();
+	for (index = 0; index < strings && pos < length; index++)
+	{
+		vector[index] = payload + pos;
+		pos += strlen(payload + pos) + 1;
+	}
+	if (index != strings || pos != length)
+		return (free(vector), NULL);
+	vector[index] = NULL;
+	return (vector);
+}
+
+// Function to run one request in a forked worker bound to the client: it
+// reads the payload itself, so a client stalling halfway only holds up its
+// own worker, until the DAEMON_TIMEOUT receive timeout drops it
+void ft_worker(t_request *req, int *fds, int client, char **env)
+{
+	struct timeval timeout = {DAEMON_TIMEOUT, 0};
+	sigset_t mask;
+	char *payload, **vector;
+	int target, next = 0, fd;
+
+	sigemptyset(&mask);
+	sigprocmask(SIG_SETMASK, &mask, NULL);
+	if (!(payload = malloc(req->length + 1)))
+		ft_exit_fatal();
+	if (setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, \
+		sizeof(timeout)) == -1 || (req->length && recv(client, payload, \
+		req->length, MSG_WAITALL) != (ssize_t)req->length) || !req->argc || \
+		!(vector = ft_split_payload(payload, req->length, \
+		req->argc + req->envc)))
+		exit(EXIT_FAILURE);
+	memmove(vector + req->argc + 1, vector + req->argc, \
+		sizeof(char *) * (req->envc + 1));
+	for (target = 0; target < 3; target++)
+	{
+		fd = (req->fds >> target & 1) ? fds[next++] \
+			: open("/dev/null", O_RDWR | O_CLOEXEC);
+		if (fd == -1 || dup2(fd, target) == -1)
+			ft_exit_fatal();
+	}
+	g_shell.status_fd = client;
+	g_shell.tty = -1;
+	if (req->envc)
+		env = vector + req->argc + 1;
+	vector[req->argc] = NULL;
+	ft_send_status(STATUS_DONE, ft_run_line(vector, req->argc, env));
+	exit(EXIT_SUCCESS);
+}
+
+// Function to read a client's next request header and hand it to a new
+// worker; returns the worker pid, or 0 when the client is gone or
+// misbehaved
+pid_t ft_serve_request(int client, char **env)
+{
+	t_request req;
+	int fds[3], count;
+	pid_t pid;
+
+	if ((count = ft_recv_request(client, &req, fds)) == -1)
+		return (0);
+	if ((pid = ft_fork()) == -1)
+		ft_exit_fatal();
+	if (pid == 0)
+		ft_worker(&req, fds, client, env);
+	while (count--)
+		close(fds[count]);
+	return (pid);
+}
+
+// Function to reap finished workers, freeing their clients for more requests;
+// a worker that failed (a short or bad request) takes its client with it
+int ft_reap_workers(t_client *clients, int count, int sigfd)
+{
+	struct signalfd_siginfo info;
+	int status, index, reaped = 0;
+	pid_t pid;
+
+	while (read(sigfd, &info, sizeof(info)) > 0)
+		;
+	while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+		for (index = 0; index < count; index++)
+			if (clients[index].worker == pid)
+			{
+				if (status)
+					close(clients[index].fd), clients[index].fd = -1;
+				clients[index].worker = 0, reaped++;
+			}
+	return (reaped);
+}
+
+// Function to open the listening socket at path (what names it in errors)
+int ft_daemon_socket(char *path, char *what)
+{
+	struct sockaddr_un addr = {AF_UNIX, {0}};
+	int fd;
+
+	if (strlen(path) >= sizeof(addr.sun_path))
+		return (ft_print_error("error: "), ft_print_error(what), \
+			ft_print_error(": socket path too long\n"), -1);
+	strcpy(addr.sun_path, path);
+	unlink(path);
+	if ((fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) == -1 || \
+		bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 || \
+		listen(fd, 128) == -1)
+		ft_exit_fatal();
+	return (fd);
+}
+
+// Function to serve requests forever: at most --jobs workers run at once,
+// and idle clients with a pending request are picked round robin
+int ft_daemon(char **env)
+{
+	t_client clients[DAEMON_CLIENTS];
+	struct pollfd pfd[DAEMON_CLIENTS + 2];
+	sigset_t mask;
+	int listen_fd, sigfd, count = 0, running = 0, next = 0, index, client;
+
+	if ((listen_fd = ft_daemon_socket(g_shell.daemon, "daemon")) == -1)
+		return (EXIT_FAILURE);
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGCHLD);
+	if (sigprocmask(SIG_BLOCK, &mask, NULL) == -1 || \
+		(sigfd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC)) == -1)
+		ft_exit_fatal();
+	while (1)
+	{
+		pfd[0] = (struct pollfd){count < DAEMON_CLIENTS ? listen_fd : -1, \
+			POLLIN, 0};
+		pfd[1] = (struct pollfd){sigfd, POLLIN, 0};
+		for (index = 0; index < count; index++)
+			pfd[index + 2] = (struct pollfd){(clients[index].worker || \
+				running >= g_shell.jobs) ? -1 : clients[index].fd, POLLIN, 0};
+		if (poll(pfd, count + 2, -1) == -1 && errno != EINTR)
+			ft_exit_fatal();
+		if (pfd[1].revents)
+			running -= ft_reap_workers(clients, count, sigfd);
+		for (index = 0; index < count && running < g_shell.jobs; index++)
+		{
+			client = (next + index) % count;
+			if (!pfd[client + 2].revents || clients[client].worker)
+				continue ;
+			if ((clients[client].worker = ft_serve_request(clients[client].fd, \
+				env)))
+				running++;
+			else
+				close(clients[client].fd), clients[client].fd = -1;
+			next = client + 1;
+		}
+		for (index = 0; index < count; index++)
+			if (clients[index].fd == -1)
+				clients[index--] = clients[--count];
+		if (pfd[0].revents && (client = accept4(listen_fd, NULL, NULL, \
+			SOCK_CLOEXEC)) != -1)
+			clients[count++] = (t_client){client, 0};
+	}
+}
+
+// Function to count the processes under pid: its children, theirs, ...
+int ft_metrics_descendants(pid_t pid)
+{
+	char path[64], list[4096], *at;
+	ssize_t len;
+	long child;
+	int fd, count = 0;
+
+	snprintf(path, sizeof(path), "/proc/%d/task/%d/children", pid, pid);
+	if ((fd = open(path, O_RDONLY | O_CLOEXEC)) == -1)
+		return (0);
+	len = read(fd, list, sizeof(list) - 1);
+	close(fd);
+	list[len > 0 ? len : 0] = '\0';
+	for (at = list; (child = strtol(at, &at, 10)) > 0;)
+		count += 1 + ft_metrics_descendants(child);
+	return (count);
+}
+
+// Function to count the open file descriptors of pid
+int ft_metrics_fds(pid_t pid)
+{
+	struct dirent *entry;
+	char path[64];
+	DIR *dir;
+	int count = 0;
+
+	snprintf(path, sizeof(path), "/proc/%d/fd", pid);
+	if (!(dir = opendir(path)))
+		return (0);
+	while ((entry = readdir(dir)))
+		count += entry->d_name[0] != '.';
+	closedir(dir);
+	return (count);
+}
+
+// Function to write the exposition page (Prometheus text format 0.0.4)
+// into page, returns its length; the gauges are read from /proc now
+int ft_metrics_render(char *page, int size)
+{
+	static const char *names[METRIC_COUNTERS] = {"commands", \
+		"exec_failures", "cd_failures", "forks", "pipes", "fatal_errors"};
+	static const char *help[METRIC_COUNTERS] = {"Commands executed.", \
+		"Stages that could not be executed.", "Failed cd builtins.", \
+		"Processes forked.", "Pipes created between stages.", \
+		"Fatal errors (failed system calls)."};
+	uint64_t seen = 0;
+	int len = 0, index;
+
+	for (index = 0; index < METRIC_COUNTERS; index++)
+		len += snprintf(page + len, size - len, "# HELP msh_%s_total %s\n"
+				"# TYPE msh_%s_total counter\nmsh_%s_total %llu\n", \
+				names[index], help[index], names[index], names[index], \
+				(unsigned long long)__atomic_load_n( \
+				&g_metrics->counter[index].value, __ATOMIC_RELAXED));
+	len += snprintf(page + len, size - len, "# HELP msh_children Live "
+			"processes under the shell.\n# TYPE msh_children gauge\n"
+			"msh_children %d\n# HELP msh_open_fds Open file descriptors of "
+			"the shell.\n# TYPE msh_open_fds gauge\nmsh_open_fds %d\n"
+			"# HELP msh_stage_duration_seconds Stage runtime, fork to reap.\n"
+			"# TYPE msh_stage_duration_seconds histogram\n", \
+			ft_metrics_descendants(g_metrics->shell), \
+			ft_metrics_fds(g_metrics->shell));
+	for (index = 0; index <= METRIC_BUCKETS; index++)
+	{
+		seen += __atomic_load_n(&g_metrics->bucket[index], __ATOMIC_RELAXED);
+		if (index < METRIC_BUCKETS)
+			len += snprintf(page + len, size - len, "msh_stage_duration_"
+					"seconds_bucket{le=\"%g\"} %llu\n", \
+					g_metric_bounds[index] / 1e9, (unsigned long long)seen);
+	}
+	return (len + snprintf(page + len, size - len, "msh_stage_duration_"
+			"seconds_bucket{le=\"+Inf\"} %llu\nmsh_stage_duration_seconds_sum "
+			"%.9f\nmsh_stage_duration_seconds_count %llu\n", \
+			(unsigned long long)seen, __atomic_load_n(&g_metrics->run_ns, \
+			__ATOMIC_RELAXED) / 1e9, (unsigned long long)seen));
+}
+
+// Function to rewrite the textfile: a temporary file renamed over it, so
+// node_exporter never reads half a page
+void ft_metrics_write(void)
+{
+	char page[METRIC_PAGE], path[4096];
+	int fd, len;
+
+	if (!g_shell.metrics_file || snprintf(path, sizeof(path), "%s.%d.tmp", \
+		g_shell.metrics_file, getpid()) >= (int)sizeof(path) || \
+		(fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)) \
+		== -1)
+		return ;
+	len = ft_metrics_render(page, sizeof(page));
+	if (write(fd, page, len) != len || close(fd) == -1 || \
+		rename(path, g_shell.metrics_file) == -1)
+		unlink(path);
+}
+
+// Function to send a whole buffer to a scraper, giving up on any error
+void ft_metrics_send(int fd, char *buf, int len)
+{
+	ssize_t done;
+
+	while (len > 0 && (done = send(fd, buf, len, MSG_NOSIGNAL)) > 0)
+		buf += done, len -= done;
+}
+
+// Function to answer one scrape: GET /metrics (or /) gets the page, any
+// other request a 404; the request line has a second to arrive
+void ft_metrics_answer(int fd)
+{
+	char request[1024], head[256], page[METRIC_PAGE];
+	struct pollfd pfd = {fd, POLLIN, 0};
+	const char *status = "404 Not Found";
+	int len = 0, got, page_len = 0;
+
+	while (len < (int)sizeof(request) - 1 && !memchr(request, '\n', len) \
+		&& poll(&pfd, 1, 1000) == 1 && \
+		(got = read(fd, request + len, sizeof(request) - 1 - len)) > 0)
+		len += got;
+	request[len] = '\0';
+	if (!strncmp(request, "GET /metrics ", 13) || \
+		!strncmp(request, "GET / ", 6))
+		status = "200 OK", page_len = ft_metrics_render(page, sizeof(page));
+	len = snprintf(head, sizeof(head), "HTTP/1.0 %s\r\nContent-Type: "
+			"text/plain; version=0.0.4\r\nContent-Length: %d\r\n"
+			"Connection: close\r\n\r\n", status, page_len);
+	ft_metrics_send(fd, head, len);
+	ft_metrics_send(fd, page, page_len);
+}
+
+// Function to serve scrapes and rewrite the textfile until the shell is
+// gone: its pidfd turns readable (kernels without pidfds: kill(pid, 0)
+// every second), then the socket is removed
+void ft_metrics_serve(int listen_fd)
+{
+	struct pollfd pfd[2];
+	int64_t now, next = 0;
+	int pidfd, timeout, client;
+
+	pidfd = syscall(SYS_pidfd_open, g_metrics->shell, 0);
+	while (pidfd != -1 || kill(g_metrics->shell, 0) == 0)
+	{
+		now = ft_clock_ns();
+		if (g_shell.metrics_file && now >= next)
+			ft_metrics_write(), next = now + METRIC_PERIOD_MS * 1000000LL;
+		timeout = g_shell.metrics_file ? (next - now) / 1000000 + 1 : -1;
+		if (pidfd == -1 && (timeout < 0 || timeout > 1000))
+			timeout = 1000;
+		pfd[0] = (struct pollfd){listen_fd, POLLIN, 0};
+		pfd[1] = (struct pollfd){pidfd, POLLIN, 0};
+		if ((poll(pfd, 2, timeout) == -1 && errno != EINTR) || pfd[1].revents)
+			break ;
+		if (pfd[0].revents && (client = accept4(listen_fd, NULL, NULL, \
+			SOCK_CLOEXEC)) != -1)
+			ft_metrics_answer(client), close(client);
+	}
+	if (g_shell.metrics)
+		unlink(g_shell.metrics);
+	_exit(EXIT_SUCCESS);
+}
+
+// Function to map the metrics and start their server: forked twice into a
+// session of its own (so no wait of the shell ever waits on it), holding
+// the socket and rewriting the textfile while the shell lives
+void ft_metrics_open(void)
+{
+	int listen_fd = -1, null_fd;
+	pid_t pid;
+
+	if ((g_metrics = mmap(NULL, sizeof(t_metrics), PROT_READ | PROT_WRITE, \
+		MAP_SHARED | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED)
+	{
+		g_metrics = NULL;
+		return ;
+	}
+	g_metrics->shell = getpid();
+	if (g_shell.metrics && \
+		(listen_fd = ft_daemon_socket(g_shell.metrics, "metrics")) == -1)
+		exit(EXIT_FAILURE);
+	if ((pid = fork()) == -1)
+		ft_exit_fatal();
+	if (pid == 0)
+	{
+		if (setsid() == -1 || (pid = fork()) == -1 || pid)
+			_exit(pid == -1);
+		if ((null_fd = open("/dev/null", O_RDWR)) != -1)
+			dup2(null_fd, STDIN_FILENO), dup2(null_fd, STDOUT_FILENO), \
+			dup2(null_fd, STDERR_FILENO);
+		if (null_fd > STDERR_FILENO)
+			close(null_fd);
+		ft_metrics_serve(listen_fd);
+	}
+	waitpid(pid, NULL, 0);
+	if (listen_fd != -1)
+		close(listen_fd);
+}
+
+// Main function to parse and execute commands
+int main(int argc, char **argv, char **env)
+{
+	int options, code;
+	int64_t start;
+
+	g_shell.status_fd = -1;
+	g_shell.capture_fd = -1;
+	g_shell.entry_fd = -1;
+	g_shell.prepare = -1;
+	g_shell.teardown = TEARDOWN_MS;
+	g_shell.tty = -1;
+	options = ft_parse_options(argv + 1);
+	if (g_shell.metrics || g_shell.metrics_file)
+		ft_metrics_open();
+	if (g_shell.daemon)
+		return (ft_daemon(env));
+	start = g_trace ? ft_clock_ns() : 0;
+	code = ft_run_line(argv + 1 + options, argc - 1 - options, env);
+	ft_trace('X', "line", g_trace ? g_trace->pid : 0, start, \
+		g_trace ? ft_clock_ns() - start : 0, NULL);
+	ft_trace_flush();
+	if (g_hists)
+		ft_hist_dump();
+	if (g_shell.cache_stats)
+		ft_cache_report();
+	if (g_metrics)
+		ft_metrics_write();
 	return (code);
 }
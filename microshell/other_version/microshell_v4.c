@@ -13,10 +13,20 @@
 #define TYPE_PIPE	4
 #define TYPE_BREAK	5
 
+#define POOL_MAX	16
+
+/*
+** One command of the group being run. The line is streamed: a ";" group is
+** parsed, executed and released before the next one is read, and argv
+** points into the process argv instead of copies, so memory stays bounded
+** by the longest group. Released nodes wait in a free list (at most
+** POOL_MAX) with their argv array, which is reused when large enough.
+*/
 typedef struct s_base
 {
     char **argv;
     int size;
+	int cap;
 	int type;
 	int fd[2];
 	struct s_base *prev;
@@ -40,21 +50,6 @@ int ft_strlen(char *str)
 	return (i);
 }
 
-char *ft_strdup(char *str)
-{
-	int size = ft_strlen(str);
-	char *new;
-
-	if (!str)
-		return (NULL);
-	if (!(new = (char *)malloc(sizeof(char) * (size + 1))))
-		return (NULL);
-	new[size] = '\0';
-	while (--size >= 0)
-		new[size] = str[size];
-	return (new);
-}
-
 /*
 **====================================
 **============Part error==============
@@ -91,26 +86,70 @@ int exit_cd_2(char *str)
 
 /*
 **====================================
-**============Part parsing============
+**============Part pool===============
 **====================================
 */
 
-void ft_lstadd_back(t_base **ptr, t_base *new)
+t_base *g_pool = NULL;
+int g_pooled = 0;
+
+t_base *node_get(int size)
+{
+	t_base *new;
+
+	if ((new = g_pool))
+	{
+		g_pool = new->next;
+		g_pooled--;
+	}
+	else if (!(new = (t_base *)calloc(1, sizeof(t_base))))
+		exit_fatal();
+	if (new->cap < size + 1)
+	{
+		free(new->argv);
+		new->cap = size + 1;
+		if (!(new->argv = (char **)malloc(sizeof(char *) * new->cap)))
+			exit_fatal();
+	}
+	new->size = size;
+	new->next = NULL;
+	new->prev = NULL;
+	return (new);
+}
+
+void node_put(t_base *node)
+{
+	if (g_pooled >= POOL_MAX)
+	{
+		free(node->argv);
+		free(node);
+		return ;
+	}
+	node->next = g_pool;
+	g_pool = node;
+	g_pooled++;
+}
+
+void pool_clear(void)
 {
-    t_base *temp;
+	t_base *temp;
 
-	if (!(*ptr))
-		*ptr = new;
-	else
+	while (g_pool)
 	{
-		temp = *ptr;
-		while (temp->next)
-			temp = temp->next;
-		temp->next = new;
-		new->prev = temp;
+		temp = g_pool->next;
+		free(g_pool->argv);
+		free(g_pool);
+		g_pool = temp;
 	}
+	g_pooled = 0;
 }
 
+/*
+**====================================
+**============Part parsing============
+**====================================
+*/
+
 int size_argv(char **argv)
 {
     int i = 0;
@@ -130,26 +169,41 @@ int check_end(char *av)
     return (0);
 }
 
-int parser_argv(t_base **ptr, char **av)
+int parser_argv(t_base **tail, char **av)
 {
     int size = size_argv(av);
     t_base *new;
 
-    if (!(new = (t_base *)malloc(sizeof(t_base))))
-        exit_fatal();
-    if (!(new->argv = (char **)malloc(sizeof(char *) * (size + 1))))
-        exit_fatal();
-    new->size = size;
-	new->next = NULL;
-	new->prev = NULL;
+    new = node_get(size);
     new->argv[size] = NULL;
     while (--size >= 0)
-        new->argv[size] = ft_strdup(av[size]);
+        new->argv[size] = av[size];
     new->type = check_end(av[new->size]);
-    ft_lstadd_back(ptr, new);
+	new->prev = *tail;
+	if (*tail)
+		(*tail)->next = new;
+	*tail = new;
     return (new->size);
 }
 
+int parser_group(t_base **ptr, char **av)
+{
+	t_base *tail = NULL;
+	int i = 0;
+
+	while (1)
+	{
+		i += parser_argv(&tail, &av[i]);
+		if (!*ptr)
+			*ptr = tail;
+		if (!av[i])
+			return (i);
+		i++;
+		if (tail->type != TYPE_PIPE || !av[i] || !strcmp(av[i], ";"))
+			return (i);
+	}
+}
+
 /*
 **====================================
 **============Part execve=============
@@ -188,7 +242,7 @@ void exec_cmd(t_base *temp, char **env)
 		if (pipe_open)
 		{
 			close(temp->fd[STDOUT]);
-			if (!temp->next || temp->type == TYPE_BREAK)
+			if (temp->type != TYPE_PIPE)
 				close(temp->fd[STDIN]);
 		}
 		if (temp->prev && temp->prev->type == TYPE_PIPE)
@@ -225,58 +279,33 @@ void exec_cmds(t_base *ptr, char **env)
 void free_all(t_base *ptr)
 {
 	t_base *temp;
-	int i;
 
 	while (ptr)
 	{
 		temp = ptr->next;
-		i = 0;
-		while (i < ptr->size)
-			free(ptr->argv[i++]);
-		free(ptr->argv);
-		free(ptr);
+		node_put(ptr);
 		ptr = temp;
 	}
-	ptr = NULL;
 }
 
 int main(int ac, char **av, char **env)
 {
-	t_base *ptr = NULL;
+	t_base *ptr;
 	int i;
 
 	i = 1;
-	if (ac > 1)
-	{
-		while (av[i])
-    	{
-            if (strcmp(av[i], ";") == 0)
-            {
-                i++;
-                continue ;
-            }
-    	    i += parser_argv(&ptr, &av[i]);
-    	    if (!av[i])
-    	        break;
-    	    else
-    	        i++;
-    	}
-	/*while (ptr)
+	while (ac > 1 && av[i])
 	{
-		
-		printf("=================\n");
-		for (i = 0; i < ptr->size; i++)
-			printf("%s\n", ptr->argv[i]);
-		printf("TYPE: %d\n", ptr->type);
-		printf("SIZE: %d\n", ptr->size);
-		printf("=================\n");
-		ptr = ptr->next;
-	}
-	(void)**env;
-	printf("END\n");*/
-		if (ptr)
-			exec_cmds(ptr, env);
+		if (strcmp(av[i], ";") == 0)
+		{
+			i++;
+			continue ;
+		}
+		ptr = NULL;
+		i += parser_group(&ptr, &av[i]);
+		exec_cmds(ptr, env);
 		free_all(ptr);
 	}
+	pool_clear();
 	return (0);
-}
\ No newline at end of file
+}
@@ -0,0 +1,257 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   grep_diff.c                                        :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: gicomlan <gicomlan@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 05:02:44 by gicomlan          #+#    #+#             */
+/*   Updated: 2026/10/19 12:41:09 by gicomlan         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/*
+** Differential test of the builtin grep against GNU grep (LC_ALL=C).
+**
+**   cc -O2 -Wall -Wextra -Werror -o grep_diff grep_diff.c
+**   ./grep_diff [-n cases] [-s seed] [-g gnu_grep] ./microshell
+**
+** Every case is a random input (short and long lines, specials, high bytes,
+** sometimes no final newline or a NUL byte) and a random pattern cut from
+** it (dots, anchors, escapes, case flips) with a random mix of -v -c -i -F.
+** GNU grep reads the input file; the builtin reads it through "<", through
+** a copy stage ("< in | grep", a ring) and as /usr/bin/grep rewritten, under
+** a random one of --simd=scalar, sse2 and avx2. Stdout, stderr (the binary
+** file notice names argv[0]) and the exit code must all be the same bytes.
+** A failing case is printed with its input left behind, in a mkstemp
+** file under $TMPDIR (default /tmp) so concurrent runs never share one.
+*/
+
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/wait.h>
+
+#define MAX_INPUT	(400 << 10)
+#define MAX_OUT		(1 << 20)
+
+typedef struct s_run
+{
+	char	out[MAX_OUT];
+	int		out_len;
+	char	err[4096];
+	int		err_len;
+	int		status;
+}	t_run;
+
+static char		g_input[4096];
+static const char	g_alpha[] = "abcABCxyz .^$\\*[]@-";
+static const char	*g_simd[] = {"--simd=scalar", "--simd=sse2", \
+	"--simd=avx2"};
+
+// Function to name the input file: a fresh mkstemp one under $TMPDIR
+// (default /tmp), so concurrent runs never write over each other's
+static void	ft_input_name(void)
+{
+	const char	*dir = getenv("TMPDIR");
+	int			fd;
+
+	snprintf(g_input, sizeof(g_input), "%s/grep_diff.XXXXXX", \
+		dir && *dir ? dir : "/tmp");
+	if ((fd = mkstemp(g_input)) == -1)
+		perror(g_input), exit(2);
+	close(fd);
+}
+
+// Function to read all of fd into buf (up to size), returns the length
+static int	ft_slurp(int fd, char *buf, int size)
+{
+	int		len = 0;
+	ssize_t	done;
+
+	while ((done = read(fd, buf + len, size - len)) > 0 && len + done < size)
+		len += done;
+	return (len + (done > 0 ? done : 0));
+}
+
+// Function to run path with LC_ALL=C, keeping its stdout, stderr and status
+static void	ft_run(char *path, char **argv, char *in, t_run *run)
+{
+	static char	*env[] = {"LC_ALL=C", "PATH=/usr/bin:/bin", NULL};
+	int			out[2], err[2], fd;
+	pid_t		pid;
+
+	if (pipe(out) == -1 || pipe(err) == -1 || (pid = fork()) == -1)
+		perror("grep_diff"), exit(2);
+	if (pid == 0)
+	{
+		if (in && (fd = open(in, O_RDONLY)) != -1)
+			dup2(fd, STDIN_FILENO), close(fd);
+		dup2(out[1], STDOUT_FILENO), dup2(err[1], STDERR_FILENO);
+		close(out[0]), close(out[1]), close(err[0]), close(err[1]);
+		execve(path, argv, env);
+		_exit(127);
+	}
+	close(out[1]), close(err[1]);
+	run->out_len = ft_slurp(out[0], run->out, MAX_OUT);
+	run->err_len = ft_slurp(err[0], run->err, sizeof(run->err));
+	close(out[0]), close(err[0]);
+	waitpid(pid, &run->status, 0);
+}
+
+// Function to write a random input file, returns its length
+static int	ft_make_input(char *buf)
+{
+	int	len = 0, lines = rand() % 200, line, size, pos, fd;
+
+	if (rand() % 8 == 0)
+		lines = 4000 + rand() % 8000;
+	for (line = 0; line < lines && len < MAX_INPUT - 300000; line++)
+	{
+		size = rand() % 10 ? rand() % 40 : rand() % 300;
+		if (rand() % 500 == 0)
+			size = 100000 + rand() % 150000;
+		for (pos = 0; pos < size; pos++)
+			buf[len++] = rand() % 50 ? g_alpha[rand() % (sizeof(g_alpha) - 1)] \
+				: 0x80 + rand() % 128;
+		buf[len++] = '\n';
+	}
+	if (len && rand() % 4 == 0)
+		len--;
+	if (len && len < 60000 && rand() % 10 == 0)
+		buf[rand() % len] = '\0';
+	if ((fd = open(g_input, O_WRONLY | O_CREAT | O_TRUNC, 0644)) == -1 || \
+		write(fd, buf, len) != len)
+		perror(g_input), exit(2);
+	close(fd);
+	return (len);
+}
+
+// Function to cut a pattern from the input: a few bytes of it, then dots,
+// case flips, anchors and escapes; -F patterns stay as cut. A stray "*" or
+// "[" now and then sends the case to the real grep the builtin falls back on,
+// and so does a trailing "\" (a bad pattern: GNU grep exits 2)
+static void	ft_make_pattern(char *input, int len, int fixed, char *pattern)
+{
+	int		size = rand() % 7, from, pos, out = 0;
+	char	c;
+
+	from = len ? rand() % len : 0;
+	if (!fixed && rand() % 6 == 0)
+		pattern[out++] = '^';
+	for (pos = 0; pos < size && from + pos < len; pos++)
+	{
+		c = input[from + pos];
+		if (c == '\n' || c == '\0')
+			break ;
+		if (rand() % 5 == 0)
+			c ^= 0x20 * ((c | 0x20) >= 'a' && (c | 0x20) <= 'z');
+		if (!fixed && rand() % 6 == 0)
+			c = '.';
+		else if (!fixed && strchr(".[]*^$\\", c))
+			pattern[out++] = '\\';
+		pattern[out++] = c;
+	}
+	if (rand() % 20 == 0)
+		pattern[out++] = "*["[rand() % 2];
+	if (!fixed && rand() % 6 == 0)
+		pattern[out++] = '$';
+	if (rand() % 25 == 0)
+		pattern[out++] = '\\';
+	pattern[out] = '\0';
+}
+
+// Function to compare one builtin run with the GNU one
+static int	ft_same(t_run *gnu, t_run *ours)
+{
+	return (gnu->status == ours->status && gnu->out_len == ours->out_len \
+		&& gnu->err_len == ours->err_len \
+		&& !memcmp(gnu->out, ours->out, gnu->out_len) \
+		&& !memcmp(gnu->err, ours->err, gnu->err_len));
+}
+
+// Function to run one case every way, returns 0 if they all agree
+static int	ft_case(char *shell, char *gnu_grep, char *input, int len)
+{
+	static t_run	gnu, ours;
+	char			pattern[64], flags[8], flag_arg[9], *tail[3], *argv[16];
+	int				count = 0, tails = 0, way, simd = 0, pos;
+
+	if (rand() % 3)
+		flags[count++] = "vciF"[rand() % 4];
+	if (rand() % 3)
+		flags[count++] = "vciF"[rand() % 4];
+	flags[count] = '\0';
+	ft_make_pattern(input, len, strchr(flags, 'F') != NULL, pattern);
+	if (count)
+		snprintf(flag_arg, sizeof(flag_arg), "-%s", flags), \
+		tail[tails++] = flag_arg;
+	tail[tails++] = "--";
+	tail[tails++] = pattern;
+	for (way = 0; way < 3; way++)
+	{
+		argv[0] = way == 2 ? gnu_grep : "grep";
+		memcpy(argv + 1, tail, tails * sizeof(char *));
+		argv[1 + tails] = NULL;
+		if (way != 1)
+			ft_run(gnu_grep, argv, g_input, &gnu);
+		pos = 0;
+		argv[pos++] = shell;
+		argv[pos++] = (char *)g_simd[simd = rand() % 3];
+		if (way == 1)
+			argv[pos++] = "<", argv[pos++] = g_input, argv[pos++] = "|";
+		argv[pos++] = way == 2 ? gnu_grep : "grep";
+		memcpy(argv + pos, tail, tails * sizeof(char *));
+		argv[pos + tails] = NULL;
+		ft_run(shell, argv, way == 1 ? NULL : g_input, &ours);
+		if (!ft_same(&gnu, &ours))
+			return (printf("grep_diff: %s way %d: grep %s -- '%s' "
+					"(status %d/%d, %d/%d bytes out)\n", g_simd[simd], way, \
+					flags, pattern, WEXITSTATUS(gnu.status), \
+					WEXITSTATUS(ours.status), gnu.out_len, ours.out_len), 1);
+	}
+	return (0);
+}
+
+int	main(int argc, char **argv)
+{
+	static char	input[MAX_INPUT];
+	char		*gnu_grep = "/usr/bin/grep";
+	unsigned	seed = time(NULL);
+	int			opt, cases = 200, index, failures = 0, len;
+
+	while ((opt = getopt(argc, argv, "n:s:g:")) != -1)
+	{
+		if (opt == 'n')
+			cases = atoi(optarg);
+		else if (opt == 's')
+			seed = strtoul(optarg, NULL, 10);
+		else if (opt == 'g')
+			gnu_grep = optarg;
+		else
+			return (2);
+	}
+	if (optind != argc - 1)
+		return (fprintf(stderr, "usage: grep_diff [-n cases] [-s seed] "
+				"[-g gnu_grep] shell\n"), 2);
+	srand(seed);
+	ft_input_name();
+	printf("grep_diff: seed %u, %d cases against %s\n", seed, cases, gnu_grep);
+	for (index = 0; index < cases; index++)
+	{
+		len = ft_make_input(input);
+		if (ft_case(argv[optind], gnu_grep, input, len) && ++failures)
+			break ;
+	}
+	if (!failures)
+		unlink(g_input);
+	else
+		printf("grep_diff: input left in %s\n", g_input);
+	printf("grep_diff: %d/%d cases failed\n", failures, index < cases ? \
+		index + 1 : cases);
+	return (failures != 0);
+}
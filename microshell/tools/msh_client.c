@@ -0,0 +1,188 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   msh_client.c                                       :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: gicomlan <gicomlan@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 18:44:51 by gicomlan          #+#    #+#             */
+/*   Updated: 2026/10/18 19:20:13 by gicomlan         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/*
+** Client for "microshell --daemon=SOCKET":
+**
+**   cc -O2 -Wall -Wextra -Werror -o msh_client msh_client.c
+**   ./msh_client [-v] [-r repeat] SOCKET /bin/ls "|" /usr/bin/grep micro
+**
+** Sends the command line and our environment, passes our stdin, stdout and
+** stderr over SCM_RIGHTS, and exits with the code the daemon reports.
+** -v prints each group's status to stderr, -r sends the same request
+** several times on one connection and prints the mean round trip.
+*/
+
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// Protocol (keep in sync with microshell.c)
+#define FRAME_MAGIC		0x3168736Du
+#define FRAME_STDIN		1
+#define FRAME_STDOUT	2
+#define FRAME_STDERR	4
+#define STATUS_GROUP	1
+#define STATUS_DONE		2
+
+typedef struct s_request
+{
+	uint32_t	magic;
+	uint32_t	argc;
+	uint32_t	envc;
+	uint32_t	fds;
+	uint32_t	length;
+}	t_request;
+
+typedef struct s_status
+{
+	uint32_t	magic;
+	int32_t		kind;
+	int32_t		code;
+}	t_status;
+
+extern char	**environ;
+
+static int	ft_connect(const char *path)
+{
+	struct sockaddr_un	addr = {AF_UNIX, {0}};
+	int					fd;
+
+	if (strlen(path) >= sizeof(addr.sun_path))
+		return (-1);
+	strcpy(addr.sun_path, path);
+	if ((fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) == -1)
+		return (-1);
+	if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+		return (close(fd), -1);
+	return (fd);
+}
+
+// Function to pack argv then environ into one NUL-separated payload
+static char	*ft_payload(char **argv, int argc, t_request *req)
+{
+	char	*payload, *pos;
+	int		index;
+
+	req->length = 0;
+	for (index = 0; index < argc; index++)
+		req->length += strlen(argv[index]) + 1;
+	for (req->envc = 0; environ[req->envc]; req->envc++)
+		req->length += strlen(environ[req->envc]) + 1;
+	if (!(pos = payload = malloc(req->length ? req->length : 1)))
+		return (NULL);
+	for (index = 0; index < argc; index++)
+		pos = stpcpy(pos, argv[index]) + 1;
+	for (index = 0; environ[index]; index++)
+		pos = stpcpy(pos, environ[index]) + 1;
+	return (payload);
+}
+
+static int	ft_send_request(int fd, t_request *req, char *payload)
+{
+	union { struct cmsghdr align; char buf[CMSG_SPACE(3 * sizeof(int))]; }
+		control;
+	int				fds[3] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO};
+	struct iovec	iov = {req, sizeof(*req)};
+	struct msghdr	msg = {0};
+	struct cmsghdr	*cmsg;
+
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control.buf;
+	msg.msg_controllen = sizeof(control.buf);
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+	if (sendmsg(fd, &msg, MSG_NOSIGNAL) != sizeof(*req))
+		return (-1);
+	if (send(fd, payload, req->length, MSG_NOSIGNAL) != (ssize_t)req->length)
+		return (-1);
+	return (0);
+}
+
+// Function to read status frames until the done frame, returns its code
+static int	ft_wait_done(int fd, int verbose)
+{
+	t_status	frame;
+	int			group = 0;
+
+	while (recv(fd, &frame, sizeof(frame), MSG_WAITALL) == sizeof(frame))
+	{
+		if (frame.magic != FRAME_MAGIC)
+			break ;
+		if (frame.kind == STATUS_DONE)
+			return (frame.code);
+		if (verbose)
+			fprintf(stderr, "msh_client: group %d exited %d\n", group, \
+				frame.code);
+		group++;
+	}
+	fprintf(stderr, "msh_client: connection lost\n");
+	return (EXIT_FAILURE);
+}
+
+static double	ft_now(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1e6 + ts.tv_nsec / 1e3);
+}
+
+int	main(int argc, char **argv)
+{
+	t_request	req;
+	char		*payload;
+	int			opt, fd, repeat = 1, verbose = 0, round, code = 0;
+	double		start;
+
+	while ((opt = getopt(argc, argv, "+vr:")) != -1)
+	{
+		if (opt == 'v')
+			verbose = 1;
+		else if (opt == 'r')
+			repeat = atoi(optarg);
+		else
+			return (2);
+	}
+	if (argc - optind < 2)
+		return (fprintf(stderr, "usage: msh_client [-v] [-r repeat] "
+				"SOCKET command...\n"), 2);
+	if ((fd = ft_connect(argv[optind])) == -1)
+		return (perror(argv[optind]), EXIT_FAILURE);
+	req = (t_request){FRAME_MAGIC, argc - optind - 1, 0, \
+		FRAME_STDIN | FRAME_STDOUT | FRAME_STDERR, 0};
+	if (!(payload = ft_payload(argv + optind + 1, argc - optind - 1, &req)))
+		return (EXIT_FAILURE);
+	start = ft_now();
+	for (round = 0; round < repeat; round++)
+	{
+		if (ft_send_request(fd, &req, payload) == -1)
+			return (perror("msh_client"), EXIT_FAILURE);
+		code = ft_wait_done(fd, verbose);
+	}
+	if (repeat > 1)
+		fprintf(stderr, "msh_client: %d requests, %.1f us per round trip\n", \
+			repeat, (ft_now() - start) / repeat);
+	free(payload);
+	close(fd);
+	return (code);
+}
@@ -0,0 +1,165 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   par_redirs.c                                       :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: gicomlan <gicomlan@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 10:12:08 by gicomlan          #+#    #+#             */
+/*   Updated: 2026/10/19 10:41:53 by gicomlan         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/*
+** Redirections on a par stage belong to the stage, not to its copies.
+**
+**   cc -O2 -Wall -Wextra -Werror -o par_redirs par_redirs.c
+**   ./par_redirs [-l lines] ./microshell
+**
+** A numbered input of several PAR_CHUNKs goes through "par N /bin/cat",
+** read through "<" (alone, or after a pipe whose output must be ignored)
+** or from "/bin/cat in |", into ">" and ">>" (onto a file that already has
+** a line). The output file must hold the input once, in order, and the
+** shell's stdout must stay empty.
+** Files are made with mkstemp under $TMPDIR (default /tmp).
+*/
+
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define CASES	5
+
+// Per case: what feeds the stage (0 nothing, 1 "/bin/echo upstream |",
+// 2 "/bin/cat in |"), whether it has "< in", and its output redirection
+static const int	g_feed[CASES] = {0, 2, 1, 2, 0};
+static const int	g_redir_in[CASES] = {1, 0, 1, 0, 1};
+static char			*g_ops[CASES] = {">", ">", ">>", ">>", ">>"};
+
+// Function to make a temporary file from template, returns its fd
+static int	ft_temp(char *path, size_t size, const char *what)
+{
+	const char	*dir = getenv("TMPDIR");
+	int			fd;
+
+	snprintf(path, size, "%s/par_redirs.%s.XXXXXX", dir && *dir ? dir \
+		: "/tmp", what);
+	if ((fd = mkstemp(path)) == -1)
+		perror(path), exit(2);
+	return (fd);
+}
+
+// Function to read a whole file, returns it (NULL if it cannot), length
+// in len
+static char	*ft_slurp(const char *path, size_t *len)
+{
+	struct stat	st;
+	char		*buf;
+	int			fd;
+
+	if ((fd = open(path, O_RDONLY)) == -1 || fstat(fd, &st) == -1 || \
+		!(buf = malloc(st.st_size + 1)) || \
+		read(fd, buf, st.st_size) != st.st_size)
+		return (fd != -1 ? close(fd) : 0, NULL);
+	close(fd);
+	*len = st.st_size;
+	return (buf);
+}
+
+// Function to run argv with stdin on /dev/null, returns how many bytes it
+// wrote to stdout, -1 if it failed
+static long	ft_run(char **argv)
+{
+	char	buf[4096];
+	long	total = 0;
+	ssize_t	done;
+	int		fds[2], status, fd;
+	pid_t	pid;
+
+	if (pipe(fds) == -1 || (pid = fork()) == -1)
+		perror("par_redirs"), exit(2);
+	if (pid == 0)
+	{
+		if ((fd = open("/dev/null", O_RDONLY)) != -1)
+			dup2(fd, STDIN_FILENO), close(fd);
+		dup2(fds[1], STDOUT_FILENO);
+		close(fds[0]), close(fds[1]);
+		execv(argv[0], argv);
+		_exit(127);
+	}
+	close(fds[1]);
+	while ((done = read(fds[0], buf, sizeof(buf))) > 0)
+		total += done;
+	close(fds[0]);
+	waitpid(pid, &status, 0);
+	return (status ? -1 : total);
+}
+
+int	main(int argc, char **argv)
+{
+	char		in[4096], out[4096], copies[8], *line[16], *want, *got;
+	size_t		want_len, got_len;
+	long		lines = 500000, index, printed;
+	int			opt, fd, pos, failures = 0, prefix;
+	FILE		*file;
+
+	while ((opt = getopt(argc, argv, "l:")) != -1)
+	{
+		if (opt == 'l')
+			lines = atol(optarg);
+		else
+			return (2);
+	}
+	if (optind != argc - 1 || lines < 1)
+		return (fprintf(stderr, "usage: par_redirs [-l lines] shell\n"), 2);
+	if (!(file = fdopen(ft_temp(in, sizeof(in), "in"), "w")))
+		return (perror(in), 2);
+	for (index = 1; index <= lines; index++)
+		fprintf(file, "%ld\n", index);
+	fclose(file);
+	close(ft_temp(out, sizeof(out), "out"));
+	if (!(want = ft_slurp(in, &want_len)))
+		return (perror(in), unlink(in), unlink(out), 2);
+	for (index = 0; index < CASES; index++)
+	{
+		prefix = !strcmp(g_ops[index], ">>");
+		if ((fd = open(out, O_WRONLY | O_TRUNC)) == -1 || \
+			(prefix && write(fd, "head\n", 5) != 5))
+			return (perror(out), unlink(in), unlink(out), 2);
+		close(fd);
+		snprintf(copies, sizeof(copies), "%ld", 2 + index % 3);
+		pos = 0;
+		line[pos++] = argv[optind];
+		if (g_feed[index])
+			line[pos++] = g_feed[index] == 1 ? "/bin/echo" : "/bin/cat", \
+			line[pos++] = g_feed[index] == 1 ? "upstream" : in, \
+			line[pos++] = "|";
+		line[pos++] = "par", line[pos++] = copies, line[pos++] = "/bin/cat";
+		if (g_redir_in[index])
+			line[pos++] = "<", line[pos++] = in;
+		line[pos++] = g_ops[index], line[pos++] = out;
+		line[pos] = NULL;
+		printed = ft_run(line);
+		got = ft_slurp(out, &got_len);
+		if (printed != 0 || !got || got_len != want_len + 5 * prefix || \
+			(prefix && memcmp(got, "head\n", 5)) || \
+			memcmp(got + 5 * prefix, want, want_len))
+			failures++, printf("par_redirs: %spar %s /bin/cat%s %s out: "
+				"%ld bytes out of the shell, %zu in the file, %zu wanted\n", \
+				(char *[]){"", "/bin/echo upstream | ", "/bin/cat in | "} \
+				[g_feed[index]], copies, g_redir_in[index] ? " < in" : "", \
+				g_ops[index], printed, got ? got_len : 0, \
+				want_len + 5 * prefix);
+		free(got);
+	}
+	free(want);
+	unlink(in), unlink(out);
+	printf("par_redirs: %d/%d cases failed (%ld lines)\n", failures, CASES, \
+		lines);
+	return (failures != 0);
+}
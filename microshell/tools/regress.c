@@ -0,0 +1,154 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   regress.c                                          :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: gicomlan <gicomlan@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 11:31:06 by gicomlan          #+#    #+#             */
+/*   Updated: 2026/10/19 13:24:18 by gicomlan         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/*
+** Fixed command lines that once went wrong, each run over and over.
+**
+**   cc -O2 -Wall -Wextra -Werror -o regress regress.c
+**   ./regress [-r scale] ./microshell
+**
+** Every case is one shell line, run "repeat" times (times scale) from a
+** fresh mkdtemp directory under $TMPDIR (default /tmp), stdin on
+** /dev/null; its stdout and stderr together must be "out" and its exit
+** code "status" every time. Lines check files they make by catting them.
+*/
+
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/wait.h>
+
+#define MAX_OUT		65536
+#define MAX_ARGS	32
+
+typedef struct s_case
+{
+	int			repeat;
+	int			status;
+	const char	*out;
+	char		*line[MAX_ARGS];
+}	t_case;
+
+static const t_case	g_cases[] = {
+	// A drained producer left in the epoll set while a later one still
+	// held its pipe until exec: the relay read it again once closed
+	{200, 1, "", {"/bin/true", "&", "/bin/false"}},
+	{100, 0, "a\nb\n", {"/bin/echo", "a", "&", "/bin/true", "&", \
+		"/bin/echo", "b"}},
+	// A cached group's ">" / ">>" file was not replayed by a hit
+	{20, 0, "a\na\na\n", {"--cache-dir=c", "cache", "/bin/echo", "a", ">", \
+		"f", ";", "/bin/rm", "f", ";", "cache", "/bin/echo", "a", ">", "f", \
+		";", "cache", "/bin/echo", "a", ">>", "f", ";", "cache", "/bin/echo", \
+		"a", ">>", "f", ";", "/bin/cat", "f"}},
+	// limit with specs but no command ran the last spec, and limit in
+	// front of (or inside) a fan-in group ran "limit" itself
+	{5, 1, "error: limit: bad arg cpu=1\n", {"limit", "cpu=1"}},
+	{5, 1, "error: limit: bad arg cpu=1\n", {"limit", "cpu=1", "&", \
+		"/bin/echo", "b"}},
+	{5, 0, "8\n6\n8\n", {"limit", "nofile=8", "/bin/sh", "-c", "ulimit -n", \
+		"&", "limit", "nofile=6", "/bin/sh", "-c", "ulimit -n", "&", \
+		"/bin/sh", "-c", "ulimit -n"}},
+	// The optimizer gave the reader of an elided "true |" /dev/null, which
+	// it can tell from the pipe it was written with
+	{5, 0, "pipe\n", {"/bin/true", "|", "/bin/sh", "-c", \
+		"test -p /dev/stdin && echo pipe"}},
+};
+
+// Function to run line once under shell, returns its exit code (-1 if it
+// did not exit), stdout and stderr in out
+static int	ft_run(char *shell, char *const *line, char *out, int *len)
+{
+	char	*argv[MAX_ARGS + 1];
+	int		fds[2], status, fd, count;
+	ssize_t	done;
+	pid_t	pid;
+
+	argv[0] = shell;
+	for (count = 0; count < MAX_ARGS && line[count]; count++)
+		argv[count + 1] = line[count];
+	argv[count + 1] = NULL;
+	if (pipe(fds) == -1 || (pid = fork()) == -1)
+		perror("regress"), exit(2);
+	if (pid == 0)
+	{
+		if ((fd = open("/dev/null", O_RDONLY)) != -1)
+			dup2(fd, STDIN_FILENO), close(fd);
+		dup2(fds[1], STDOUT_FILENO), dup2(fds[1], STDERR_FILENO);
+		close(fds[0]), close(fds[1]);
+		execv(shell, argv);
+		_exit(127);
+	}
+	close(fds[1]);
+	*len = 0;
+	while ((done = read(fds[0], out + *len, MAX_OUT - 1 - *len)) > 0)
+		*len += done;
+	out[*len] = '\0';
+	close(fds[0]);
+	waitpid(pid, &status, 0);
+	return (WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+}
+
+// Function to run a case from an empty directory, returns 1 if it failed
+static int	ft_case(char *shell, const t_case *c, int scale)
+{
+	const char	*dir = getenv("TMPDIR");
+	char		path[PATH_MAX], out[MAX_OUT];
+	int			round, status, len, index;
+
+	for (round = 0; round < c->repeat * scale; round++)
+	{
+		snprintf(path, sizeof(path), "%s/regress.XXXXXX", dir && *dir ? \
+			dir : "/tmp");
+		if (!mkdtemp(path) || chdir(path) == -1)
+			perror(path), exit(2);
+		status = ft_run(shell, c->line, out, &len);
+		if (status != c->status || strcmp(out, c->out))
+		{
+			printf("regress: round %d:", round);
+			for (index = 0; index < MAX_ARGS && c->line[index]; index++)
+				printf(" '%s'", c->line[index]);
+			printf(" (status %d, %d wanted)\n%s", status, c->status, out);
+			printf("%s-- wanted --\n%s", len && out[len - 1] != '\n' ? \
+				"\n" : "", c->out);
+			return (printf("-- left in %s --\n", path), 1);
+		}
+		if (system("rm -rf -- *") == -1 || chdir("/") == -1 || \
+			rmdir(path) == -1)
+			perror(path), exit(2);
+	}
+	return (0);
+}
+
+int	main(int argc, char **argv)
+{
+	char	shell[PATH_MAX];
+	int		opt, scale = 1, failures = 0, count, index;
+
+	while ((opt = getopt(argc, argv, "r:")) != -1)
+	{
+		if (opt == 'r')
+			scale = atoi(optarg);
+		else
+			return (2);
+	}
+	if (optind != argc - 1 || scale < 1 || !realpath(argv[optind], shell))
+		return (fprintf(stderr, "usage: regress [-r scale] shell\n"), 2);
+	count = sizeof(g_cases) / sizeof(*g_cases);
+	for (index = 0; index < count; index++)
+		failures += ft_case(shell, &g_cases[index], scale);
+	printf("regress: %d/%d cases failed\n", failures, count);
+	return (failures != 0);
+}
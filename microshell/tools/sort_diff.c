@@ -0,0 +1,283 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   sort_diff.c                                        :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: gicomlan <gicomlan@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 06:58:12 by gicomlan          #+#    #+#             */
+/*   Updated: 2026/10/19 11:05:42 by gicomlan         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/*
+** Differential test of the builtin sort against GNU sort (LC_ALL=C).
+**
+**   cc -O2 -Wall -Wextra -Werror -o sort_diff sort_diff.c
+**   ./sort_diff [-n cases] [-s seed] [-g gnu_sort] ./microshell
+**
+** Every case is a random input (blank- and ":"-separated fields of words,
+** signed and fractional numbers with leading zeros, duplicates, high bytes,
+** sometimes no final newline or a NUL byte) and a random mix of -n -r -u,
+** -t and up to three -k specs with ".C" offsets and b/n/r letters. GNU sort
+** reads the input file; the builtin reads it through "<", through a copy
+** stage ("< in | sort", a ring) and as /usr/bin/sort rewritten, each time
+** under a random --sort-threads and, one case in three, a --sort-mem small
+** enough to spill dozens of runs and merge them in more than one pass. Now
+** and then an option the builtin leaves to the real sort (-s, -f, -k0) is
+** thrown in. Stdout, stderr and the exit code must all be the same bytes.
+** A failing case is printed with its input left behind, in a mkstemp
+** file under $TMPDIR (default /tmp) so concurrent runs never share one.
+*/
+
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/wait.h>
+
+#define MAX_INPUT	(1 << 20)
+#define MAX_OUT		(2 << 20)
+
+typedef struct s_run
+{
+	char	out[MAX_OUT];
+	int		out_len;
+	char	err[4096];
+	int		err_len;
+	int		status;
+}	t_run;
+
+static char		g_input[4096];
+static const char	*g_words[] = {"a", "b", "ab", "B", "zz", "-", "x.y", \
+	"\xe9t\xe9", "0", "-0", "007", "12", "-12", "3.50", "3.5", ".5", "-.5", \
+	"1e3", "+4", "10", "9", "-"};
+
+// Function to name the input file: a fresh mkstemp one under $TMPDIR
+// (default /tmp), so concurrent runs never write over each other's
+static void	ft_input_name(void)
+{
+	const char	*dir = getenv("TMPDIR");
+	int			fd;
+
+	snprintf(g_input, sizeof(g_input), "%s/sort_diff.XXXXXX", \
+		dir && *dir ? dir : "/tmp");
+	if ((fd = mkstemp(g_input)) == -1)
+		perror(g_input), exit(2);
+	close(fd);
+}
+
+// Function to read all of fd into buf (up to size), returns the length
+static int	ft_slurp(int fd, char *buf, int size)
+{
+	int		len = 0;
+	ssize_t	done;
+
+	while ((done = read(fd, buf + len, size - len)) > 0 && len + done < size)
+		len += done;
+	return (len + (done > 0 ? done : 0));
+}
+
+// Function to run path with LC_ALL=C, keeping its stdout, stderr and status
+static void	ft_run(char *path, char **argv, char *in, t_run *run)
+{
+	static char	*env[] = {"LC_ALL=C", "PATH=/usr/bin:/bin", NULL};
+	int			out[2], err[2], fd;
+	pid_t		pid;
+
+	if (pipe(out) == -1 || pipe(err) == -1 || (pid = fork()) == -1)
+		perror("sort_diff"), exit(2);
+	if (pid == 0)
+	{
+		if (in && (fd = open(in, O_RDONLY)) != -1)
+			dup2(fd, STDIN_FILENO), close(fd);
+		dup2(out[1], STDOUT_FILENO), dup2(err[1], STDERR_FILENO);
+		close(out[0]), close(out[1]), close(err[0]), close(err[1]);
+		execve(path, argv, env);
+		_exit(127);
+	}
+	close(out[1]), close(err[1]);
+	run->out_len = ft_slurp(out[0], run->out, MAX_OUT);
+	run->err_len = ft_slurp(err[0], run->err, sizeof(run->err));
+	close(out[0]), close(err[0]);
+	waitpid(pid, &run->status, 0);
+}
+
+// Function to write a random input file, returns its length
+static int	ft_make_input(char *buf)
+{
+	int	len = 0, lines = rand() % 100, line, fields, field, from, fd;
+
+	if (rand() % 6 == 0)
+		lines = 5000 + rand() % 30000;
+	for (line = 0; line < lines && len < MAX_INPUT - 4096; line++)
+	{
+		if (line > 1 && rand() % 8 == 0)
+		{
+			from = rand() % len;
+			while (from && buf[from - 1] != '\n')
+				from--;
+			while (buf[from] != '\n')
+				buf[len++] = buf[from++];
+			buf[len++] = '\n';
+			continue ;
+		}
+		fields = rand() % 5;
+		for (field = 0; field < fields; field++)
+		{
+			if (field || rand() % 4 == 0)
+				len += sprintf(buf + len, "%s", (char *[]){" ", "  ", "\t", \
+					":", " :", ""}[rand() % 6]);
+			len += sprintf(buf + len, "%s", g_words[rand() % \
+				(sizeof(g_words) / sizeof(*g_words))]);
+		}
+		buf[len++] = '\n';
+	}
+	if (len && rand() % 4 == 0)
+		len--;
+	if (len && rand() % 20 == 0)
+		buf[rand() % len] = '\0';
+	if ((fd = open(g_input, O_WRONLY | O_CREAT | O_TRUNC, 0644)) == -1 || \
+		write(fd, buf, len) != len)
+		perror(g_input), exit(2);
+	close(fd);
+	return (len);
+}
+
+// Function to make a random -k spec: F[.C][bnr][,F[.C][bnr]]
+static void	ft_make_key(char *spec)
+{
+	int	len;
+
+	len = sprintf(spec, "%d", 1 + rand() % 3);
+	if (rand() % 4 == 0)
+		len += sprintf(spec + len, ".%d", 1 + rand() % 3);
+	len += sprintf(spec + len, "%s", (char *[]){"", "", "n", "r", "b", \
+		"bn", "nr"}[rand() % 7]);
+	if (rand() % 3 == 0)
+		return ;
+	len += sprintf(spec + len, ",%d", 1 + rand() % 3);
+	if (rand() % 4 == 0)
+		len += sprintf(spec + len, ".%d", rand() % 3);
+	sprintf(spec + len, "%s", (char *[]){"", "", "n", "r", "b"}[rand() % 5]);
+}
+
+// Function to make a random option list into tail, returns its length
+static int	ft_make_options(char **tail, char (*specs)[32], char *flags)
+{
+	int	count = 0, keys = rand() % 4, key, len = 0;
+
+	if (rand() % 2)
+		flags[len++] = 'n';
+	if (rand() % 3 == 0)
+		flags[len++] = 'r';
+	if (rand() % 3 == 0)
+		flags[len++] = 'u';
+	flags[len] = '\0';
+	if (len)
+		tail[count++] = flags - 1;
+	if (rand() % 3 == 0)
+		tail[count++] = "-t", tail[count++] = (char *[]){":", " ", "\t", \
+			"."}[rand() % 4];
+	for (key = 0; key < keys; key++)
+	{
+		ft_make_key(specs[key]);
+		tail[count++] = "-k", tail[count++] = specs[key];
+	}
+	if (rand() % 30 == 0)
+		tail[count++] = (char *[]){"-s", "-f", "-k0", "-t::"}[rand() % 4];
+	return (count);
+}
+
+// Function to compare one builtin run with the GNU one
+static int	ft_same(t_run *gnu, t_run *ours)
+{
+	return (gnu->status == ours->status && gnu->out_len == ours->out_len \
+		&& gnu->err_len == ours->err_len \
+		&& !memcmp(gnu->out, ours->out, gnu->out_len) \
+		&& !memcmp(gnu->err, ours->err, gnu->err_len));
+}
+
+// Function to run one case every way, returns 0 if they all agree
+static int	ft_case(char *shell, char *gnu_sort)
+{
+	static t_run	gnu, ours;
+	char			specs[4][32], flags[8] = "-", threads[32], mem[32];
+	char			*tail[16], *argv[32];
+	int				tails, way, pos, index;
+
+	tails = ft_make_options(tail, specs, flags + 1);
+	for (way = 0; way < 3; way++)
+	{
+		argv[0] = way == 2 ? gnu_sort : "sort";
+		memcpy(argv + 1, tail, tails * sizeof(char *));
+		argv[1 + tails] = NULL;
+		if (way != 1)
+			ft_run(gnu_sort, argv, g_input, &gnu);
+		pos = 0;
+		argv[pos++] = shell;
+		snprintf(threads, sizeof(threads), "--sort-threads=%d", \
+			1 + rand() % 8);
+		argv[pos++] = threads;
+		snprintf(mem, sizeof(mem), "--sort-mem=%d", rand() % 3 ? 1 << 24 : \
+			2048 + rand() % 30000);
+		argv[pos++] = mem;
+		if (way == 1)
+			argv[pos++] = "<", argv[pos++] = g_input, argv[pos++] = "|";
+		argv[pos++] = way == 2 ? gnu_sort : "sort";
+		memcpy(argv + pos, tail, tails * sizeof(char *));
+		argv[pos + tails] = NULL;
+		ft_run(shell, argv, way == 1 ? NULL : g_input, &ours);
+		if (ft_same(&gnu, &ours))
+			continue ;
+		printf("sort_diff: way %d, %s %s: sort", way, threads, mem);
+		for (index = 0; index < tails; index++)
+			printf(" '%s'", tail[index]);
+		return (printf(" (status %d/%d, %d/%d bytes out)\n", \
+			WEXITSTATUS(gnu.status), WEXITSTATUS(ours.status), gnu.out_len, \
+			ours.out_len), 1);
+	}
+	return (0);
+}
+
+int	main(int argc, char **argv)
+{
+	static char	input[MAX_INPUT];
+	char		*gnu_sort = "/usr/bin/sort";
+	unsigned	seed = time(NULL);
+	int			opt, cases = 200, index, failures = 0;
+
+	while ((opt = getopt(argc, argv, "n:s:g:")) != -1)
+	{
+		if (opt == 'n')
+			cases = atoi(optarg);
+		else if (opt == 's')
+			seed = strtoul(optarg, NULL, 10);
+		else if (opt == 'g')
+			gnu_sort = optarg;
+		else
+			return (2);
+	}
+	if (optind != argc - 1)
+		return (fprintf(stderr, "usage: sort_diff [-n cases] [-s seed] "
+				"[-g gnu_sort] shell\n"), 2);
+	srand(seed);
+	ft_input_name();
+	printf("sort_diff: seed %u, %d cases against %s\n", seed, cases, gnu_sort);
+	for (index = 0; index < cases; index++)
+	{
+		ft_make_input(input);
+		if (ft_case(argv[optind], gnu_sort) && ++failures)
+			break ;
+	}
+	if (!failures)
+		unlink(g_input);
+	else
+		printf("sort_diff: input left in %s\n", g_input);
+	printf("sort_diff: %d/%d cases failed\n", failures, index < cases ? \
+		index + 1 : cases);
+	return (failures != 0);
+}
@@ -0,0 +1,565 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   stress.c                                           :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: gicomlan <gicomlan@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/18 16:52:10 by gicomlan          #+#    #+#             */
+/*   Updated: 2026/10/18 17:31:45 by gicomlan         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/*
+** Random pipeline stress tester for any microshell binary.
+**
+**   cc -O2 -Wall -Wextra -Werror -o stress stress.c
+**   ./stress [-n cases] [-s seed] [-t timeout] [-m max_bytes] [-d max_depth]
+**            [-g max_groups] [-f nofile] [-o results.csv] ./microshell
+**
+** Every case is a random mix of "cd", ";" and "|" chains whose stages are
+** this very binary (--emit, --pass, --sink), so the expected output is
+** known and every stage checks it did not inherit stray descriptors.
+** A case fails on a hang (watchdog), a wrong output, a leaked fd, or a
+** child the shell left behind (still running or zombie). Failing cases
+** are shrunk to the smallest command line that still fails.
+*/
+
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <dirent.h>
+#include <time.h>
+#include <limits.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+
+#define MAX_GROUPS		64
+#define MAX_DEPTH		256
+#define CHUNK			65536
+
+#define GROUP_PIPE		0
+#define GROUP_CD_OK		1
+#define GROUP_CD_BAD	2
+#define GROUP_CD_ARGS	3
+
+#define FAIL_NONE		0
+#define FAIL_HANG		1
+#define FAIL_OUTPUT		2
+#define FAIL_LEAK		3
+#define FAIL_ORPHAN		4
+#define FAIL_ZOMBIE		5
+
+typedef struct s_group
+{
+	int			type;
+	int			depth;
+	long long	bytes;
+	const char	*dir;
+}	t_group;
+
+typedef struct s_case
+{
+	t_group	groups[MAX_GROUPS];
+	int		count;
+}	t_case;
+
+typedef struct s_config
+{
+	const char	*shell;
+	char		self[PATH_MAX];
+	char		cwd[PATH_MAX];
+	int			cases;
+	int			timeout;
+	int			max_depth;
+	int			max_groups;
+	int			nofile;
+	long long	max_bytes;
+	FILE		*results;
+}	t_config;
+
+typedef struct s_run
+{
+	int		fail;
+	int		status;
+	double	seconds;
+	char	*out;
+	size_t	out_len;
+	char	*err;
+	size_t	err_len;
+}	t_run;
+
+static const char	*g_fail_name[] = {"ok", "hang", "output", "fd-leak", \
+	"orphan", "zombie"};
+static const char	*g_dirs[] = {"/", "/tmp", NULL};
+
+static double	ft_now(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec + ts.tv_nsec / 1e9);
+}
+
+/*
+**====================================
+**========Part stage helpers==========
+**====================================
+*/
+
+// Function to complain about any descriptor above stderr a stage inherited
+static void	ft_check_fds(const char *role)
+{
+	DIR				*dir;
+	struct dirent	*entry;
+	int				fd;
+
+	if (!(dir = opendir("/proc/self/fd")))
+		return ;
+	while ((entry = readdir(dir)))
+	{
+		fd = atoi(entry->d_name);
+		if (entry->d_name[0] != '.' && fd > 2 && fd != dirfd(dir))
+			fprintf(stderr, "stress: leak: fd %d open in %s\n", fd, role);
+	}
+	closedir(dir);
+}
+
+static int	ft_emit(long long bytes)
+{
+	static char	buf[CHUNK];
+	ssize_t		done;
+	int			i;
+
+	ft_check_fds("emit");
+	for (i = 0; i < CHUNK; i++)
+		buf[i] = (i % 64 == 63) ? '\n' : 'a' + i % 26;
+	while (bytes > 0)
+	{
+		done = write(STDOUT_FILENO, buf, bytes < CHUNK ? bytes : CHUNK);
+		if (done == -1 && errno == EINTR)
+			continue ;
+		if (done == -1)
+			return (1);
+		bytes -= done;
+	}
+	return (0);
+}
+
+static int	ft_pass_or_sink(int sink)
+{
+	static char	buf[CHUNK];
+	long long	total = 0;
+	ssize_t		done;
+	char		cwd[PATH_MAX];
+
+	ft_check_fds(sink ? "sink" : "pass");
+	while ((done = read(STDIN_FILENO, buf, CHUNK)) != 0)
+	{
+		if (done == -1 && errno == EINTR)
+			continue ;
+		if (done == -1)
+			return (1);
+		total += done;
+		if (!sink && write(STDOUT_FILENO, buf, done) != done)
+			return (1);
+	}
+	if (sink)
+		printf("sink %lld %s\n", total, getcwd(cwd, sizeof(cwd)) ? cwd : "?");
+	return (0);
+}
+
+/*
+**====================================
+**========Part case generation========
+**====================================
+*/
+
+// Function to draw a data volume, log-uniform between 0 and max
+static long long	ft_random_bytes(long long max)
+{
+	int	bits = 0;
+
+	if (max <= 0 || rand() % 8 == 0)
+		return (0);
+	while ((1LL << bits) < max)
+		bits++;
+	bits = rand() % (bits + 1);
+	return (((long long)rand() << 31 | rand()) % ((1LL << bits) + 1) % (max + 1));
+}
+
+static void	ft_generate(t_case *c, t_config *cfg)
+{
+	t_group	*g;
+	int		i;
+
+	c->count = 1 + rand() % cfg->max_groups;
+	for (i = 0; i < c->count; i++)
+	{
+		g = &c->groups[i];
+		g->type = rand() % 5 ? GROUP_PIPE : 1 + rand() % 3;
+		g->depth = 1 + rand() % cfg->max_depth;
+		g->bytes = ft_random_bytes(cfg->max_bytes);
+		g->dir = g_dirs[rand() % 2];
+	}
+}
+
+// Function to build the microshell argv for a case (NULL terminated)
+static char	**ft_build_argv(t_case *c, t_config *cfg, char bytes[][32])
+{
+	char	**av;
+	int		n = 0, i, d;
+
+	av = malloc(sizeof(char *) * (2 + c->count * (MAX_DEPTH * 3 + 4)));
+	av[n++] = (char *)cfg->shell;
+	for (i = 0; i < c->count; i++)
+	{
+		if (i)
+			av[n++] = ";";
+		if (c->groups[i].type != GROUP_PIPE)
+		{
+			av[n++] = "cd";
+			if (c->groups[i].type == GROUP_CD_OK)
+				av[n++] = (char *)c->groups[i].dir;
+			else if (c->groups[i].type == GROUP_CD_BAD)
+				av[n++] = "/nonexistent/stress";
+			else
+				av[n++] = "/", av[n++] = "/tmp";
+			continue ;
+		}
+		snprintf(bytes[i], 32, "%lld", c->groups[i].bytes);
+		av[n++] = cfg->self, av[n++] = "--emit", av[n++] = bytes[i];
+		for (d = 1; d < c->groups[i].depth; d++)
+			av[n++] = "|", av[n++] = cfg->self, av[n++] = "--pass";
+		av[n++] = "|", av[n++] = cfg->self, av[n++] = "--sink";
+	}
+	av[n] = NULL;
+	return (av);
+}
+
+// Function to compute what the pipelines of a case must print
+static char	*ft_expected(t_case *c, t_config *cfg)
+{
+	char		*out, *cwd = cfg->cwd;
+	size_t		len = 0;
+	int			i;
+
+	out = malloc(c->count * (PATH_MAX + 64) + 1);
+	out[0] = 0;
+	for (i = 0; i < c->count; i++)
+	{
+		if (c->groups[i].type == GROUP_CD_OK)
+			cwd = (char *)c->groups[i].dir;
+		else if (c->groups[i].type == GROUP_PIPE)
+			len += sprintf(out + len, "sink %lld %s\n", c->groups[i].bytes, cwd);
+	}
+	return (out);
+}
+
+static long long	ft_case_bytes(t_case *c)
+{
+	long long	total = 0;
+	int			i;
+
+	for (i = 0; i < c->count; i++)
+		if (c->groups[i].type == GROUP_PIPE)
+			total += c->groups[i].bytes * c->groups[i].depth;
+	return (total);
+}
+
+/*
+**====================================
+**========Part running a case=========
+**====================================
+*/
+
+static void	ft_append(char **buf, size_t *len, char *data, size_t n)
+{
+	*buf = realloc(*buf, *len + n + 1);
+	memcpy(*buf + *len, data, n);
+	*len += n;
+	(*buf)[*len] = 0;
+}
+
+// Function to collect the shell's stdout/stderr until it exits or times out
+static int	ft_drain(int out_fd, int err_fd, t_run *run, double deadline)
+{
+	struct pollfd	pfd[2] = {{out_fd, POLLIN, 0}, {err_fd, POLLIN, 0}};
+	char			buf[CHUNK];
+	ssize_t			done;
+	int				open_fds = 2, i, left;
+
+	while (open_fds)
+	{
+		left = (int)((deadline - ft_now()) * 1000);
+		if (left <= 0 || poll(pfd, 2, left) == 0)
+		{
+			for (i = 0; i < 2; i++)
+				if (pfd[i].fd >= 0)
+					close(pfd[i].fd);
+			return (-1);
+		}
+		for (i = 0; i < 2; i++)
+		{
+			if (pfd[i].fd < 0 || !(pfd[i].revents & (POLLIN | POLLHUP)))
+				continue ;
+			done = read(pfd[i].fd, buf, sizeof(buf));
+			if (done > 0 && i == 0)
+				ft_append(&run->out, &run->out_len, buf, done);
+			else if (done > 0)
+				ft_append(&run->err, &run->err_len, buf, done);
+			else if (done == 0 || errno != EINTR)
+				close(pfd[i].fd), pfd[i].fd = -1, open_fds--;
+		}
+	}
+	return (0);
+}
+
+// Function to find processes the shell left to us (we are their subreaper)
+static int	ft_check_leftovers(void)
+{
+	DIR				*dir;
+	struct dirent	*entry;
+	char			path[64], state;
+	int				pid, ppid, fail = FAIL_NONE;
+	FILE			*stat;
+
+	if (!(dir = opendir("/proc")))
+		return (FAIL_NONE);
+	while ((entry = readdir(dir)))
+	{
+		if ((pid = atoi(entry->d_name)) <= 0)
+			continue ;
+		snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+		if (!(stat = fopen(path, "r")))
+			continue ;
+		if (fscanf(stat, "%*d (%*[^)]) %c %d", &state, &ppid) == 2 \
+			&& ppid == getpid())
+		{
+			fail = (state == 'Z') ? FAIL_ZOMBIE : FAIL_ORPHAN;
+			kill(pid, SIGKILL);
+		}
+		fclose(stat);
+	}
+	closedir(dir);
+	while (waitpid(-1, NULL, WNOHANG) > 0)
+		;
+	return (fail);
+}
+
+static void	ft_run_case(t_case *c, t_config *cfg, t_run *run)
+{
+	char			bytes[MAX_GROUPS][32], **av, *expected;
+	int				out[2], err[2], status;
+	pid_t			pid;
+	struct rlimit	lim;
+	double			start;
+
+	memset(run, 0, sizeof(*run));
+	av = ft_build_argv(c, cfg, bytes);
+	if (pipe2(out, O_CLOEXEC) == -1 || pipe2(err, O_CLOEXEC) == -1)
+		perror("stress: pipe"), exit(2);
+	start = ft_now();
+	if ((pid = fork()) == 0)
+	{
+		setpgid(0, 0);
+		dup2(out[1], STDOUT_FILENO), dup2(err[1], STDERR_FILENO);
+		lim.rlim_cur = lim.rlim_max = cfg->nofile;
+		if (cfg->nofile > 0)
+			setrlimit(RLIMIT_NOFILE, &lim);
+		execv(cfg->shell, av);
+		_exit(127);
+	}
+	close(out[1]), close(err[1]);
+	if (ft_drain(out[0], err[0], run, start + cfg->timeout) == -1)
+	{
+		run->fail = FAIL_HANG;
+		kill(-pid, SIGKILL);
+	}
+	waitpid(pid, &status, 0);
+	run->seconds = ft_now() - start;
+	run->status = status;
+	expected = ft_expected(c, cfg);
+	if (!run->fail && strstr(run->err ? run->err : "", "stress: leak"))
+		run->fail = FAIL_LEAK;
+	if (!run->fail && strcmp(run->out ? run->out : "", expected))
+		run->fail = FAIL_OUTPUT;
+	status = ft_check_leftovers();
+	if (!run->fail)
+		run->fail = status;
+	kill(-pid, SIGKILL);
+	free(expected);
+	free(av);
+}
+
+static void	ft_free_run(t_run *run)
+{
+	free(run->out);
+	free(run->err);
+}
+
+/*
+**====================================
+**==========Part minimizing===========
+**====================================
+*/
+
+static int	ft_still_fails(t_case *c, t_config *cfg, int kind)
+{
+	t_run	run;
+
+	ft_run_case(c, cfg, &run);
+	ft_free_run(&run);
+	return (run.fail == kind);
+}
+
+// Function to shrink a failing case: drop groups, stages, then bytes
+static void	ft_minimize(t_case *c, t_config *cfg, int kind)
+{
+	t_case	try;
+	int		changed = 1, i;
+
+	while (changed)
+	{
+		changed = 0;
+		for (i = 0; i < c->count && c->count > 1; i++)
+		{
+			try = *c;
+			memmove(&try.groups[i], &try.groups[i + 1], \
+				(try.count - i - 1) * sizeof(t_group));
+			try.count--;
+			if (ft_still_fails(&try, cfg, kind))
+				*c = try, changed = 1, i--;
+		}
+		for (i = 0; i < c->count; i++)
+		{
+			try = *c;
+			if (try.groups[i].type != GROUP_PIPE)
+				continue ;
+			if (try.groups[i].depth > 1 && (try.groups[i].depth /= 2, 1) \
+				&& ft_still_fails(&try, cfg, kind))
+				*c = try, changed = 1;
+			try = *c;
+			if (try.groups[i].bytes > 0 && (try.groups[i].bytes /= 2, 1) \
+				&& ft_still_fails(&try, cfg, kind))
+				*c = try, changed = 1;
+		}
+	}
+}
+
+static void	ft_print_case(FILE *out, t_case *c, t_config *cfg)
+{
+	char	bytes[MAX_GROUPS][32], **av;
+	int		i;
+
+	av = ft_build_argv(c, cfg, bytes);
+	for (i = 0; av[i]; i++)
+		fprintf(out, (strchr(av[i], '|') || strchr(av[i], ';')) ? "'%s'%s" \
+			: "%s%s", av[i], av[i + 1] ? " " : "\n");
+	free(av);
+}
+
+/*
+**====================================
+**============Part main===============
+**====================================
+*/
+
+static int	ft_usage(void)
+{
+	fprintf(stderr, "usage: stress [-n cases] [-s seed] [-t timeout] "
+		"[-m max_bytes] [-d max_depth] [-g max_groups] [-f nofile] "
+		"[-o results.csv] shell\n");
+	return (2);
+}
+
+static int	ft_parse_args(int argc, char **argv, t_config *cfg, unsigned *seed)
+{
+	int	opt;
+
+	cfg->cases = 100, cfg->timeout = 10, cfg->max_depth = 8;
+	cfg->max_groups = 6, cfg->nofile = 30, cfg->max_bytes = 1 << 20;
+	*seed = time(NULL);
+	while ((opt = getopt(argc, argv, "n:s:t:m:d:g:f:o:")) != -1)
+	{
+		if (opt == 'n')
+			cfg->cases = atoi(optarg);
+		else if (opt == 's')
+			*seed = strtoul(optarg, NULL, 10);
+		else if (opt == 't')
+			cfg->timeout = atoi(optarg);
+		else if (opt == 'm')
+			cfg->max_bytes = strtoll(optarg, NULL, 10);
+		else if (opt == 'd')
+			cfg->max_depth = atoi(optarg);
+		else if (opt == 'g')
+			cfg->max_groups = atoi(optarg);
+		else if (opt == 'f')
+			cfg->nofile = atoi(optarg);
+		else if (opt == 'o' && !(cfg->results = fopen(optarg, "we")))
+			return (perror(optarg), 0);
+		else if (opt == '?')
+			return (0);
+	}
+	if (optind != argc - 1 || cfg->max_depth < 1 || cfg->max_groups < 1)
+		return (0);
+	cfg->max_depth = cfg->max_depth > MAX_DEPTH ? MAX_DEPTH : cfg->max_depth;
+	cfg->max_groups = cfg->max_groups > MAX_GROUPS ? MAX_GROUPS \
+		: cfg->max_groups;
+	cfg->shell = argv[optind];
+	return (1);
+}
+
+int	main(int argc, char **argv)
+{
+	t_config	cfg;
+	t_case		c;
+	t_run		run;
+	unsigned	seed;
+	int			i, failures = 0;
+
+	if (argc == 3 && !strcmp(argv[1], "--emit"))
+		return (ft_emit(strtoll(argv[2], NULL, 10)));
+	if (argc == 2 && !strcmp(argv[1], "--pass"))
+		return (ft_pass_or_sink(0));
+	if (argc == 2 && !strcmp(argv[1], "--sink"))
+		return (ft_pass_or_sink(1));
+	memset(&cfg, 0, sizeof(cfg));
+	if (!ft_parse_args(argc, argv, &cfg, &seed))
+		return (ft_usage());
+	if (!realpath("/proc/self/exe", cfg.self) || !getcwd(cfg.cwd, PATH_MAX))
+		return (perror("stress"), 2);
+	prctl(PR_SET_CHILD_SUBREAPER, 1);
+	signal(SIGPIPE, SIG_IGN);
+	srand(seed);
+	printf("stress: seed %u, %d cases against %s\n", seed, cfg.cases, cfg.shell);
+	if (cfg.results)
+		fprintf(cfg.results, "case,groups,bytes,seconds,mib_per_s,result\n");
+	for (i = 0; i < cfg.cases; i++)
+	{
+		ft_generate(&c, &cfg);
+		ft_run_case(&c, &cfg, &run);
+		if (cfg.results)
+			fprintf(cfg.results, "%d,%d,%lld,%.6f,%.1f,%s\n", i, c.count, \
+				ft_case_bytes(&c), run.seconds, ft_case_bytes(&c) \
+				/ run.seconds / (1 << 20), g_fail_name[run.fail]);
+		ft_free_run(&run);
+		if (!run.fail)
+			continue ;
+		failures++;
+		printf("case %d: %s, minimizing...\n", i, g_fail_name[run.fail]);
+		ft_minimize(&c, &cfg, run.fail);
+		ft_print_case(stdout, &c, &cfg);
+	}
+	printf("stress: %d/%d cases failed\n", failures, cfg.cases);
+	if (cfg.results)
+		fclose(cfg.results);
+	return (failures != 0);
+}
@@ -0,0 +1,96 @@
+/* ************************************************************************** */
+/*                                                                            */
+/*                                                        :::      ::::::::   */
+/*   usdt.h                                             :+:      :+:    :+:   */
+/*                                                    +:+ +:+         +:+     */
+/*   By: gicomlan <gicomlan@student.42.fr>          +#+  +:+       +#+        */
+/*                                                +#+#+#+#+#+   +#+           */
+/*   Created: 2026/10/19 03:12:26 by gicomlan          #+#    #+#             */
+/*   Updated: 2026/10/19 03:47:53 by gicomlan         ###   ########.fr       */
+/*                                                                            */
+/* ************************************************************************** */
+
+/*
+** Static probes (USDT) of the "microshell" provider, for bpftrace/perf:
+**
+**   MSH_PROBE2(fork, pid, argv0)
+**
+** Each probe is one nop in the code plus a .note.stapsdt entry telling the
+** tracer where the nop is and where its arguments live (register, stack
+** slot or constant). Nothing runs unless a tracer patches the nop, and
+** there is no semaphore, so arguments must stay cheap to compute.
+**
+** <sys/sdt.h> (systemtap-sdt-dev) is used when present. Otherwise, on
+** x86-64 and aarch64 with a GNU compiler, the same notes are emitted here,
+** every argument widened to a signed 64-bit value ("-8@<operand>"). On any
+** other target, or with -DMSH_NO_USDT, probes expand to nothing.
+*/
+
+#ifndef USDT_H
+# define USDT_H
+
+# if defined(MSH_NO_USDT)
+#  define MSH_USDT_NONE
+# elif defined(__has_include)
+#  if __has_include(<sys/sdt.h>)
+#   include <sys/sdt.h>
+#   define MSH_USDT_SYS
+#  endif
+# endif
+
+# if defined(MSH_USDT_SYS)
+#  define MSH_PROBE1(name, a) DTRACE_PROBE1(microshell, name, a)
+#  define MSH_PROBE2(name, a, b) DTRACE_PROBE2(microshell, name, a, b)
+#  define MSH_PROBE3(name, a, b, c) DTRACE_PROBE3(microshell, name, a, b, c)
+#  define MSH_PROBE4(name, a, b, c, d) \
+	DTRACE_PROBE4(microshell, name, a, b, c, d)
+
+# elif !defined(MSH_USDT_NONE) && defined(__GNUC__) && \
+	(defined(__x86_64__) || defined(__aarch64__))
+
+// The note layout of <sys/sdt.h>: pc of the nop, the .stapsdt.base
+// anchor (lets tools account for prelink), semaphore (none), then the
+// provider, name and argument strings
+#  define MSH_USDT(name, args, ...) __asm__ __volatile__ ( \
+	"990:	nop\n" \
+	"	.pushsection .note.stapsdt,\"?\",\"note\"\n" \
+	"	.balign 4\n" \
+	"	.4byte 992f-991f, 994f-993f, 3\n" \
+	"991:	.asciz \"stapsdt\"\n" \
+	"992:	.balign 4\n" \
+	"993:	.8byte 990b\n" \
+	"	.8byte _.stapsdt.base\n" \
+	"	.8byte 0\n" \
+	"	.asciz \"microshell\"\n" \
+	"	.asciz \"" #name "\"\n" \
+	"	.asciz \"" args "\"\n" \
+	"994:	.balign 4\n" \
+	"	.popsection\n" \
+	"	.ifndef _.stapsdt.base\n" \
+	"	.pushsection .stapsdt.base,\"aG\",\"progbits\"," \
+	".stapsdt.base,comdat\n" \
+	"	.weak _.stapsdt.base\n" \
+	"	.hidden _.stapsdt.base\n" \
+	"_.stapsdt.base: .space 1\n" \
+	"	.size _.stapsdt.base, 1\n" \
+	"	.popsection\n" \
+	"	.endif\n" \
+	:: __VA_ARGS__)
+#  define MSH_ARG(x) "nor" ((long)(x))
+#  define MSH_PROBE1(name, a) MSH_USDT(name, "-8@%0", MSH_ARG(a))
+#  define MSH_PROBE2(name, a, b) \
+	MSH_USDT(name, "-8@%0 -8@%1", MSH_ARG(a), MSH_ARG(b))
+#  define MSH_PROBE3(name, a, b, c) MSH_USDT(name, "-8@%0 -8@%1 -8@%2", \
+	MSH_ARG(a), MSH_ARG(b), MSH_ARG(c))
+#  define MSH_PROBE4(name, a, b, c, d) MSH_USDT(name, \
+	"-8@%0 -8@%1 -8@%2 -8@%3", MSH_ARG(a), MSH_ARG(b), MSH_ARG(c), \
+	MSH_ARG(d))
+
+# else
+#  define MSH_PROBE1(name, a) ((void)0)
+#  define MSH_PROBE2(name, a, b) ((void)0)
+#  define MSH_PROBE3(name, a, b, c) ((void)0)
+#  define MSH_PROBE4(name, a, b, c, d) ((void)0)
+# endif
+
+#endif